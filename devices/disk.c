@@ -48,6 +48,10 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors that one READ SECTOR or WRITE SECTOR command can
+   transfer.  A sector count of 0 in the register means 256. */
+#define PIO_SECTOR_MAX 256
+
 /* An ATA device. */
 struct disk {
 	char name[8];               /* Name, e.g. "hd0:1". */
@@ -85,6 +89,7 @@ static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
 
 static void select_sector (struct disk *, disk_sector_t);
+static void select_sectors (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -250,6 +255,78 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	lock_release (&c->lock);
 }
 
+/* Reads CNT consecutive sectors, starting at SEC_NO, from disk D.
+   The sectors are scattered across BUFFERS: each buffer receives
+   BUF_SECTORS consecutive sectors, so BUFFERS must have CNT /
+   BUF_SECTORS entries.  Up to PIO_SECTOR_MAX sectors are transferred
+   by each disk command, rather than one as disk_read() does.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_scatter (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *const buffers[], size_t buf_sectors) {
+	struct channel *c;
+	size_t i = 0;
+
+	ASSERT (d != NULL);
+	ASSERT (buf_sectors > 0 && cnt % buf_sectors == 0);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	while (i < cnt) {
+		size_t run = cnt - i < PIO_SECTOR_MAX ? cnt - i : PIO_SECTOR_MAX;
+		size_t end = i + run;
+
+		select_sectors (d, sec_no + i, run);
+		issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+		for (; i < end; i++) {
+			sema_down (&c->completion_wait);
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+						sec_no + (disk_sector_t) i);
+			input_sector (c, (uint8_t *) buffers[i / buf_sectors]
+					+ i % buf_sectors * DISK_SECTOR_SIZE);
+			d->read_cnt++;
+		}
+	}
+	lock_release (&c->lock);
+}
+
+/* Writes CNT consecutive sectors, starting at SEC_NO, to disk D.
+   The data is gathered from BUFFERS, as in disk_read_scatter().
+   Returns after the disk has acknowledged receiving the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_gather (struct disk *d, disk_sector_t sec_no, size_t cnt,
+		void *const buffers[], size_t buf_sectors) {
+	struct channel *c;
+	size_t i = 0;
+
+	ASSERT (d != NULL);
+	ASSERT (buf_sectors > 0 && cnt % buf_sectors == 0);
+
+	c = d->channel;
+	lock_acquire (&c->lock);
+	while (i < cnt) {
+		size_t run = cnt - i < PIO_SECTOR_MAX ? cnt - i : PIO_SECTOR_MAX;
+		size_t end = i + run;
+
+		select_sectors (d, sec_no + i, run);
+		issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+		for (; i < end; i++) {
+			if (!wait_while_busy (d))
+				PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+						sec_no + (disk_sector_t) i);
+			output_sector (c, (uint8_t *) buffers[i / buf_sectors]
+					+ i % buf_sectors * DISK_SECTOR_SIZE);
+			sema_down (&c->completion_wait);
+			d->write_cnt++;
+		}
+	}
+	lock_release (&c->lock);
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -406,13 +483,21 @@ print_ata_string (char *string, size_t size) {
    use LBA mode.) */
 static void
 select_sector (struct disk *d, disk_sector_t sec_no) {
+	select_sectors (d, sec_no, 1);
+}
+
+/* Like select_sector(), but selects CNT sectors starting at
+   SEC_NO, for a single command to transfer. */
+static void
+select_sectors (struct disk *d, disk_sector_t sec_no, size_t cnt) {
 	struct channel *c = d->channel;
 
-	ASSERT (sec_no < d->capacity);
-	ASSERT (sec_no < (1UL << 28));
+	ASSERT (cnt > 0 && cnt <= PIO_SECTOR_MAX);
+	ASSERT (sec_no + cnt <= d->capacity);
+	ASSERT (sec_no + cnt <= (1UL << 28));
 
 	select_device_wait (d);
-	outb (reg_nsect (c), 1);
+	outb (reg_nsect (c), cnt % PIO_SECTOR_MAX);
 	outb (reg_lbal (c), sec_no);
 	outb (reg_lbam (c), sec_no >> 8);
 	outb (reg_lbah (c), (sec_no >> 16));
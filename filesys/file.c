@@ -113,6 +113,17 @@ file_write_at (struct file *file, const void *buffer, off_t size,
 	return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Writes SIZE bytes into FILE, starting at offset FILE_OFS, which must
+ * be sector-aligned, from the CNT pages in PAGES, in as few disk
+ * transfers as possible.  Returns the number of bytes actually
+ * written, which may be less than SIZE if end of file is reached.
+ * The file's current position is unaffected. */
+off_t
+file_write_pages_at (struct file *file, void *const pages[], size_t cnt,
+		off_t size, off_t file_ofs) {
+	return inode_write_pages_at (file->inode, pages, cnt, size, file_ofs);
+}
+
 /* Prevents write operations on FILE's underlying inode
  * until file_allow_write() is called or FILE is closed. */
 void
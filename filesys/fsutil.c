@@ -39,7 +39,7 @@ fsutil_cat (char **argv) {
 	file = filesys_open (file_name);
 	if (file == NULL)
 		PANIC ("%s: open failed", file_name);
-	buffer = palloc_get_page (PAL_ASSERT);
+	buffer = palloc_get_page (PAL_ASSERT | PAL_TAG (MEM_FILESYS));
 	for (;;) {
 		off_t pos = file_tell (file);
 		off_t n = file_read (file, buffer, PGSIZE);
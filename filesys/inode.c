@@ -6,6 +6,7 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -19,6 +20,9 @@ struct inode_disk {
 	uint32_t unused[125];               /* Not used. */
 };
 
+/* Sectors per page. */
+#define SECTORS_PER_PAGE (PGSIZE / DISK_SECTOR_SIZE)
+
 /* Returns the number of sectors to allocate for an inode SIZE
  * bytes long. */
 static inline size_t
@@ -287,6 +291,45 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	return bytes_written;
 }
 
+/* Writes SIZE bytes into INODE, starting at OFFSET, which must be
+ * page-aligned, from the CNT pages in PAGES, each of which holds the
+ * next PGSIZE bytes.  A file's sectors are contiguous, so whole pages
+ * go to disk in one gathered transfer, and only a partial last sector
+ * is written through a bounce buffer.  Returns the number of bytes
+ * actually written, which may be less than SIZE if end of file is
+ * reached. */
+off_t
+inode_write_pages_at (struct inode *inode, void *const pages[], size_t cnt,
+		off_t size, off_t offset) {
+	size_t page_cnt, sectors;
+	off_t done;
+
+	ASSERT (offset % PGSIZE == 0);
+
+	if (inode->deny_write_cnt || offset >= inode_length (inode))
+		return 0;
+	if (size > inode_length (inode) - offset)
+		size = inode_length (inode) - offset;
+	if ((size_t) size > cnt * PGSIZE)
+		size = cnt * PGSIZE;
+
+	/* Whole pages, then the whole sectors of the last page. */
+	page_cnt = size / PGSIZE;
+	if (page_cnt > 0)
+		disk_write_gather (filesys_disk, byte_to_sector (inode, offset),
+				page_cnt * SECTORS_PER_PAGE, pages, SECTORS_PER_PAGE);
+	done = page_cnt * PGSIZE;
+	sectors = (size - done) / DISK_SECTOR_SIZE;
+	if (sectors > 0)
+		disk_write_gather (filesys_disk, byte_to_sector (inode, offset + done),
+				sectors, &pages[page_cnt], sectors);
+	done += sectors * DISK_SECTOR_SIZE;
+	if (done < size)
+		inode_write_at (inode, (uint8_t *) pages[page_cnt]
+				+ done % PGSIZE, size - done, offset + done);
+	return size;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
@@ -1,6 +1,7 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stddef.h>
 #include "filesys/off_t.h"
 
 struct inode;
@@ -17,6 +18,8 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_write_pages_at (struct file *, void *const pages[], size_t cnt,
+		off_t size, off_t start);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -0,0 +1,19 @@
+#ifndef __LIB_MADVISE_H
+#define __LIB_MADVISE_H
+
+/* Advice that a user program gives madvise() about how it will use a
+   range of its memory.  Shared between the kernel and user
+   programs. */
+enum madvise_advice {
+	MADV_NORMAL,                /* No special treatment. */
+	MADV_RANDOM,                /* Random access: no fault-around. */
+	MADV_SEQUENTIAL,            /* Sequential access: map further ahead
+	                               of faults and age pages behind. */
+	MADV_WILLNEED,              /* Needed soon: read in what free
+	                               memory allows. */
+	MADV_DONTNEED,              /* Not needed: free the frames.
+	                               Anonymous pages read back as zero. */
+	MADV_POPULATE               /* Fault in the whole range now. */
+};
+
+#endif /* lib/madvise.h */
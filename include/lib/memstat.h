@@ -0,0 +1,100 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+#include <stdint.h>
+
+/* Kernel memory usage statistics, as reported by the "memstat"
+   kernel action and returned to user programs by get_memstat().
+   The layout is shared between the kernel and user programs. */
+
+/* What a page obtained from the page allocator is used for. */
+enum mem_tag {
+	MEM_OTHER,                  /* Not tagged. */
+	MEM_THREAD,                 /* Thread structures and kernel stacks. */
+	MEM_PAGETABLE,              /* Page tables. */
+	MEM_MALLOC,                 /* malloc() arenas and big blocks. */
+	MEM_VM,                     /* User frames and VM bookkeeping. */
+	MEM_FILESYS,                /* File system buffers. */
+	MEM_TAG_CNT
+};
+
+/* Maximum number of malloc() descriptors reported. */
+#define MEMSTAT_DESC_CNT 10
+
+/* One page allocator pool. */
+struct memstat_pool {
+	uint64_t total_pages;       /* Pages managed by the pool. */
+	uint64_t used_pages;        /* Pages currently allocated. */
+	uint64_t peak_pages;        /* Maximum of used_pages so far. */
+	uint64_t failed_cnt;        /* Allocations that could not be met. */
+};
+
+/* One malloc() descriptor, that is, one size class. */
+struct memstat_desc {
+	uint64_t block_size;        /* Size of each block in bytes. */
+	uint64_t arena_cnt;         /* Arenas (pages) owned. */
+	uint64_t used_blocks;       /* Blocks handed out. */
+	uint64_t free_blocks;       /* Free blocks in the arenas. */
+};
+
+struct memstat {
+	struct memstat_pool kernel_pool;
+	struct memstat_pool user_pool;
+	uint64_t tag_pages[MEM_TAG_CNT];    /* Allocated pages by tag. */
+
+	uint64_t desc_cnt;                  /* Valid entries in descs[]. */
+	struct memstat_desc descs[MEMSTAT_DESC_CNT];
+	uint64_t big_block_cnt;             /* malloc() blocks over 2 kB. */
+	uint64_t big_block_pages;           /* Pages they occupy. */
+};
+
+/* Classes of page faults. */
+enum fault_class {
+	FAULT_LAZY,                 /* Page of the executable read in. */
+	FAULT_ZERO,                 /* Zero-filled page first touched. */
+	FAULT_SWAP,                 /* Anonymous page brought back from swap. */
+	FAULT_FILE,                 /* File-backed page read or shared. */
+	FAULT_STACK,                /* Stack grown. */
+	FAULT_COW,                  /* Write to a shared or zero frame. */
+	FAULT_INVALID,              /* Fault that could not be handled. */
+	FAULT_CLASS_CNT
+};
+
+/* Virtual memory counters of the calling process, returned by
+   get_procstat().  A fault is major if it read the page from disk,
+   and minor otherwise. */
+struct procstat {
+	uint64_t resident_pages;    /* Frames that its pages map. */
+	uint64_t frame_quota;       /* Frames it may keep before others. */
+	uint64_t fault_cnt;         /* Page faults taken. */
+	uint64_t evicted_cnt;       /* Pages evicted from it. */
+	uint64_t minor_cnt;         /* Minor page faults. */
+	uint64_t major_cnt;         /* Major page faults. */
+	uint64_t swap_in_cnt;       /* Pages read from the swap disk. */
+	uint64_t swap_out_cnt;      /* Pages written to the swap disk. */
+	uint64_t pagetable_pages;   /* Pages its page tables take. */
+	uint64_t class_cnt[FAULT_CLASS_CNT];    /* Page faults by class. */
+};
+
+/* Fault latency histogram buckets.  Bucket 0 counts faults handled in
+   less than 2**FAULT_HIST_SHIFT CPU cycles, and each later bucket a
+   range 4 times as wide as the one before, except that the last
+   one has no upper bound. */
+#define FAULT_HIST_CNT 8
+#define FAULT_HIST_SHIFT 10
+
+/* Page faults of one class, over all processes. */
+struct fault_class_stat {
+	uint64_t cnt;               /* Faults. */
+	uint64_t cycles;            /* CPU cycles spent handling them. */
+	uint64_t max_cycles;        /* Longest one. */
+	uint64_t hist[FAULT_HIST_CNT];      /* Faults by latency. */
+};
+
+/* Page fault statistics of the whole system, returned by
+   get_faultstat(). */
+struct faultstat {
+	struct fault_class_stat classes[FAULT_CLASS_CNT];
+};
+
+#endif /* lib/memstat.h */
@@ -0,0 +1,11 @@
+#ifndef __LIB_MSYNC_H
+#define __LIB_MSYNC_H
+
+/* Flags for msync(), which writes back the modified pages of file
+   mappings.  Shared between the kernel and user programs. */
+enum msync_flags {
+	MS_ASYNC = 1,               /* Start writing back, do not wait. */
+	MS_SYNC = 4                 /* Write back before returning. */
+};
+
+#endif /* lib/msync.h */
@@ -0,0 +1,28 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* File descriptor actions for spawn(), which starts a new process
+   running an executable without copying the caller's address space.
+   The child gets a copy of the caller's file descriptors, and then
+   the actions are applied to it in order.  Shared between the kernel
+   and user programs. */
+
+/* Most actions that one spawn() takes. */
+#define SPAWN_ACTION_MAX 16
+
+/* Most arguments, including the program name, that one spawn()
+   passes. */
+#define SPAWN_ARG_MAX 64
+
+enum spawn_op {
+	SPAWN_CLOSE,                /* Close FD, if it is open. */
+	SPAWN_DUP2                  /* Make NEWFD refer to FD's file. */
+};
+
+struct spawn_action {
+	int op;                     /* SPAWN_CLOSE or SPAWN_DUP2. */
+	int fd;                     /* Descriptor acted on. */
+	int newfd;                  /* Target of SPAWN_DUP2. */
+};
+
+#endif /* lib/spawn.h */
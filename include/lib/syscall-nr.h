@@ -36,6 +36,17 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Memory management extensions. */
+	SYS_MEMSTAT,                /* Report kernel memory usage. */
+	SYS_BRK,                    /* Set the end of the heap. */
+	SYS_MADVISE,                /* Advise on memory use. */
+	SYS_PROCSTAT,               /* Report the process's memory usage. */
+	SYS_FAULTSTAT,              /* Report page fault statistics. */
+	SYS_MSYNC,                  /* Write back a file mapping. */
+
+	/* Process extensions. */
+	SYS_SPAWN,                  /* Start a process from an executable. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -42,6 +43,23 @@ int dup2(int oldfd, int newfd);
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
 
+/* Memory management extensions. */
+struct memstat;
+bool get_memstat (struct memstat *);
+struct procstat;
+bool get_procstat (struct procstat *);
+struct faultstat;
+bool get_faultstat (struct faultstat *);
+int brk (void *addr);
+void *sbrk (intptr_t increment);
+int madvise (void *addr, size_t length, int advice);
+int msync (void *addr, size_t length, int flags);
+
+/* Process extensions. */
+struct spawn_action;
+pid_t spawn (const char *file, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt);
+
 /* Project 4 only. */
 bool chdir (const char *dir);
 bool mkdir (const char *dir);
@@ -0,0 +1,34 @@
+#ifndef THREADS_HEAPPROF_H
+#define THREADS_HEAPPROF_H
+
+#include <stddef.h>
+
+/* Allocation-site heap profiler.
+
+   Built only when the kernel is compiled with -DHEAPPROF (run
+   "make HEAPPROF=1" after "make clean").  Otherwise the hooks
+   below expand to nothing, so the allocators are unchanged. */
+
+/* Allocator that a profiled allocation came from. */
+enum heapprof_kind {
+	HEAPPROF_MALLOC,            /* malloc(), calloc(), realloc(). */
+	HEAPPROF_PALLOC             /* palloc_get_multiple(). */
+};
+
+#ifdef HEAPPROF
+void heapprof_init (void);
+void heapprof_alloc (enum heapprof_kind, void *, size_t);
+void heapprof_free (void *);
+void heapprof_move (void *, void *);
+void heapprof_print (void);
+
+#define HEAPPROF_ALLOC(KIND, PTR, SIZE) heapprof_alloc (KIND, PTR, SIZE)
+#define HEAPPROF_FREE(PTR) heapprof_free (PTR)
+#define HEAPPROF_MOVE(FROM, TO) heapprof_move (FROM, TO)
+#else
+#define HEAPPROF_ALLOC(KIND, PTR, SIZE) ((void) 0)
+#define HEAPPROF_FREE(PTR) ((void) 0)
+#define HEAPPROF_MOVE(FROM, TO) ((void) 0)
+#endif
+
+#endif /* threads/heapprof.h */
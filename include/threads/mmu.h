@@ -2,18 +2,34 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
+void pml4_pcid_init (void);
+void pml4_print_stats (void);
+void pml4_pt_init (uint64_t mem_end);
+size_t pml4_table_pages (uint64_t *pml4);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
+bool pml4_for_each_range (uint64_t *pml4, void *upage, size_t page_cnt,
+		pte_for_each_func *, void *);
+bool pml4_map_range (uint64_t *pml4, void *upage, void *const kpages[],
+		size_t page_cnt, bool rw);
+void pml4_unmap_range (uint64_t *pml4, void *upage, size_t page_cnt);
+void pml4_protect_range (uint64_t *pml4, void *upage, size_t page_cnt,
+		bool rw);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_remap_page (uint64_t *pml4, void *upage, void *kpage);
+bool pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+void pml4_clear_huge_page (uint64_t *pml4, void *upage);
+bool pml4_split_huge_page (uint64_t *pml4, void *upage);
 void pml4_clear_page (uint64_t *pml4, void *upage);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
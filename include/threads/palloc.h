@@ -1,8 +1,10 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <memstat.h>
 
 /* How to allocate pages. */
 enum palloc_flags {
@@ -11,13 +13,28 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* Tags an allocation with enum mem_tag TAG, for memory accounting.
+   Untagged allocations are accounted as MEM_OTHER. */
+#define PAL_TAG_SHIFT 3
+#define PAL_TAG(TAG) ((enum palloc_flags) ((TAG) << PAL_TAG_SHIFT))
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
+/* Moves the user page at FROM to TO.  See palloc_set_migrate(). */
+typedef bool palloc_migrate_func (void *from, void *to);
+
 uint64_t palloc_init (void);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_get_stats (struct memstat *);
+size_t palloc_user_pool (void **base);
+size_t palloc_user_free (void);
+void palloc_set_migrate (palloc_migrate_func *);
+bool palloc_compact (size_t page_cnt);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
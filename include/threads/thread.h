@@ -106,6 +106,8 @@ struct thread {
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4;                     /* Page map level 4 */
+	struct child_status *child_status;  /* Exit status for its parent. */
+	struct list children;               /* Statuses of its children. */
 #endif
 
 	// 프로젝트 2 USERPROG를 위해 추가한 아이들
@@ -117,6 +119,24 @@ struct thread {
 #ifdef VM
 	/* Table for whole virtual memory owned by thread. */
 	struct supplemental_page_table spt;
+	void *heap_start;                   /* Start of the brk() heap. */
+	void *heap_end;                     /* Current program break. */
+	void *user_rsp;                     /* User rsp on entry to a syscall. */
+
+	/* Owned by vm/vm.c. */
+	size_t rss;                         /* Frames that its pages map. */
+	size_t frame_quota;                 /* Frames it may keep; 0 if unset. */
+	bool over_quota;                    /* RSS > FRAME_QUOTA? */
+	uint64_t fault_cnt;                 /* Page faults taken. */
+	uint64_t evicted_cnt;               /* Pages evicted from it. */
+	uint64_t major_cnt;                 /* Page faults that read from disk. */
+	uint64_t swap_in_cnt;               /* Pages read from the swap disk. */
+	uint64_t swap_out_cnt;              /* Pages written to the swap disk. */
+	uint64_t fault_class_cnt[FAULT_CLASS_CNT]; /* Page faults by class. */
+	int64_t pff_start;                  /* Tick that the PFF window began. */
+	size_t pff_faults;                  /* Page faults in the PFF window. */
+	size_t swap_ra_window;              /* Swap readahead window; 0 if unset. */
+	size_t swap_ra_hits;                /* Pages read ahead used since. */
 #endif
 
 	/* Owned by thread.c. */
@@ -155,6 +175,7 @@ int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
+size_t threads_ready (void);
 
 void do_iret (struct intr_frame *tf);
 
@@ -2,10 +2,19 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Slots in a file descriptor table, which takes one page. */
+#define FD_MAX (PGSIZE / sizeof (struct file *))
+
+struct spawn_action;
 
 tid_t process_create_initd (const char *file_name);
 tid_t process_fork (const char *name, struct intr_frame *if_);
 int process_exec (void *f_name);
+tid_t process_spawn (const char *file, char **argv, int argc,
+		const struct spawn_action *actions, size_t action_cnt);
+bool process_add_child (struct thread *);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (struct thread *next);
@@ -1,13 +1,32 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stdint.h>
 #include "vm/vm.h"
 struct page;
+struct zswap_entry;
 enum vm_type;
 
+/* Swap slot of a page that has never been swapped out. */
+#define SWAP_SLOT_NONE SIZE_MAX
+
 struct anon_page {
+	size_t slot;                /* Swap slot, or SWAP_SLOT_NONE. */
+	struct zswap_entry *zentry; /* Compressed copy in zswap, or null. */
+	uint8_t zskip;              /* Evictions left that skip zswap. */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+void anon_init_page (struct page *page);
+void anon_drop_slot (struct page *page);
+void anon_share_slot (struct page *page, const struct page *from);
+bool anon_copy_swapped (struct page *page, const struct page *from);
+
+/* Most pages that anon_swap_out_batch() takes at once. */
+#define ANON_BATCH_MAX 16
+
+bool anon_swap_out_batch (struct page *pages[], size_t cnt);
+void anon_swap_in_run (struct page *pages[], void *kvas[], size_t cnt);
+void anon_print_stats (void);
 
 #endif
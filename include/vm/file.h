@@ -6,11 +6,20 @@
 struct page;
 enum vm_type;
 
+/* A page whose contents come from a file: a page of an executable,
+ * see vm_map_text(), which becomes anonymous when written, or a page
+ * of a mapping made by do_mmap(), which is written back when dirty.  AUX of an
+ * uninitialized VM_FILE page is a malloc()'d struct file_page, which
+ * the page takes over when it is initialized. */
 struct file_page {
+	struct file *file;          /* File that holds the contents. */
+	off_t ofs;                  /* Offset of the page in FILE. */
+	size_t read_bytes;          /* Bytes from FILE; the rest is zero. */
 };
 
 void vm_file_init (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
+void file_init_page (struct page *page, const struct file_page *info);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
@@ -0,0 +1,35 @@
+#ifndef VM_RADIX_H
+#define VM_RADIX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Radix tree that maps user page numbers to pointers.  Used by the
+ * supplemental page table to find a process's pages. */
+struct radix {
+	struct radix_node *root;    /* Top node, or null if empty. */
+	size_t cnt;                 /* Values in the tree. */
+	size_t node_cnt;            /* Nodes allocated. */
+};
+
+/* Keys must be less than this, which covers all user page numbers. */
+#define RADIX_KEY_MAX ((uint64_t) 1 << 30)
+
+/* Called for a value with key KEY.  A walk stops if it returns
+ * false. */
+typedef bool radix_walk_func (uint64_t key, void *value, void *aux);
+
+/* Called for a value with key KEY once it is out of the tree. */
+typedef void radix_destroy_func (uint64_t key, void *value, void *aux);
+
+void radix_init (struct radix *);
+void *radix_lookup (const struct radix *, uint64_t key);
+bool radix_insert (struct radix *, uint64_t key, void *value);
+void *radix_remove (struct radix *, uint64_t key);
+void radix_remove_range (struct radix *, uint64_t start, uint64_t end,
+		radix_destroy_func *, void *aux);
+bool radix_walk (const struct radix *, uint64_t start, uint64_t end,
+		radix_walk_func *, void *aux);
+
+#endif /* vm/radix.h */
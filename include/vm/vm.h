@@ -1,6 +1,8 @@
 #ifndef VM_VM_H
 #define VM_VM_H
 #include <stdbool.h>
+#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
 
 enum vm_type {
@@ -24,9 +26,21 @@ enum vm_type {
 	VM_MARKER_END = (1 << 31),
 };
 
+/* Marks anonymous pages that belong to the user stack. */
+#define VM_STACK VM_MARKER_0
+
+/* Marks the VMAs of file mappings made by do_mmap(). */
+#define VM_MMAP VM_MARKER_1
+
+/* Maximum size of the user stack.  The heap may not grow into
+ * this region. */
+#define STACK_MAX (1 << 20)
+
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/radix.h"
+#include "vm/vma.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -46,6 +60,12 @@ struct page {
 	struct frame *frame;   /* Back reference for frame */
 
 	/* Your implementation */
+	struct list_elem frame_elem; /* Element in frame's pages. */
+	struct thread *owner;       /* Process that maps this page. */
+	bool writable;              /* Writable by the user? */
+	bool around;                /* Mapped by fault-around, unchecked? */
+	bool readahead;             /* Read in by swap readahead, unmapped? */
+	uint8_t advice;             /* MADV_NORMAL, _RANDOM or _SEQUENTIAL. */
 
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
@@ -62,7 +82,32 @@ struct page {
 /* The representation of "frame" */
 struct frame {
 	void *kva;
-	struct page *page;
+	struct list pages;     /* Pages that map this frame. */
+	size_t page_cnt;       /* Number of elements in PAGES. */
+	bool pinned;           /* Must not be moved or evicted. */
+	uint64_t checksum;     /* Contents hash at the last merge scan. */
+	bool checksummed;      /* CHECKSUM is set? */
+	struct hash_elem text_elem; /* Element in the text cache. */
+	struct inode *text_inode; /* Executable whose text it caches, or null. */
+	off_t text_ofs;        /* Offset of the page in TEXT_INODE. */
+	size_t text_bytes;     /* Bytes of the page from TEXT_INODE. */
+	struct huge_page *huge; /* Huge page it is part of, or null. */
+};
+
+/* Pages in a huge page, which one page directory entry maps. */
+#define HUGE_PAGE_CNT 512
+#define HUGE_PAGE_SIZE (HUGE_PAGE_CNT * PGSIZE)
+
+/* A huge page: 2 MB of zero-filled anonymous memory, backed by an
+ * aligned run of physically contiguous frames.  Its pages have no
+ * entries in the spt until it is split into ordinary pages.  Every
+ * frame table slot of the run points to FRAME, which stays pinned. */
+struct huge_page {
+	struct list_elem elem;      /* Element in the spt's huge pages. */
+	uint8_t *va;                /* First user address, 2 MB aligned. */
+	struct thread *owner;       /* Process that maps it. */
+	bool writable;              /* Writable by the user? */
+	struct frame frame;         /* The run of frames. */
 };
 
 /* The function table for page operations.
@@ -85,6 +130,9 @@ struct page_operations {
  * We don't want to force you to obey any specific design for this struct.
  * All designs up to you for this. */
 struct supplemental_page_table {
+	struct radix pages;         /* Pages keyed by user page number. */
+	struct list vmas;           /* Mapped ranges, as struct vma. */
+	struct list huges;          /* Huge pages, as struct huge_page. */
 };
 
 #include "threads/thread.h"
@@ -97,6 +145,12 @@ struct page *spt_find_page (struct supplemental_page_table *spt,
 bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
+extern size_t fault_around_pages;
+extern size_t merge_pages_per_pass;
+extern int64_t merge_interval;
+extern bool pff_enabled;
+extern bool thp_enabled;
+
 void vm_init (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
@@ -107,6 +161,21 @@ bool vm_alloc_page_with_initializer (enum vm_type type, void *upage,
 		bool writable, vm_initializer *init, void *aux);
 void vm_dealloc_page (struct page *page);
 bool vm_claim_page (void *va);
+bool vm_user_page_ok (const void *va, bool write);
+void vm_free_frame (struct page *page);
+bool vm_unmap_page (struct page *page);
+size_t vm_free_swap_slots (void);
+void vm_print_stats (void);
+void *vm_brk (void *addr);
+int vm_madvise (void *addr, size_t length, int advice);
+int vm_msync (void *addr, size_t length, int flags);
+bool vm_map_file (void *start, void *end, struct file *file, off_t ofs,
+		bool writable);
+void vm_unmap_mapping (void *addr);
+struct procstat;
+void vm_get_procstat (struct procstat *);
+struct faultstat;
+void vm_get_faultstat (struct faultstat *);
 enum vm_type page_get_type (struct page *page);
 
 #endif  /* VM_VM_H */
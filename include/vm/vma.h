@@ -0,0 +1,36 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+
+/* A virtual memory area: a page-aligned range of a process's address
+ * space that is mapped, and how.  Pages of the range that have no entry
+ * in the process's supplemental page table are zero-filled anonymous
+ * memory that nothing has touched yet. */
+struct vma {
+	struct list_elem elem;      /* Element in the process's VMA list. */
+	uint8_t *start;             /* First byte. */
+	uint8_t *end;               /* Byte past the last. */
+	int type;                   /* VM_ANON or VM_FILE, plus markers. */
+	struct file *file;          /* File the range was mapped from, or null. */
+	off_t ofs;                  /* Offset of START in FILE. */
+	bool writable;              /* Writable by the user? */
+	uint8_t advice;             /* MADV_NORMAL, _RANDOM or _SEQUENTIAL. */
+};
+
+struct vma *vma_find (struct list *vmas, const void *va);
+bool vma_covers (struct list *vmas, const void *start, const void *end);
+bool vma_map (struct list *vmas, void *start, void *end, int type,
+		struct file *file, off_t ofs, bool writable);
+bool vma_unmap (struct list *vmas, void *start, void *end);
+bool vma_advise (struct list *vmas, void *start, void *end, int advice);
+bool vma_copy (struct list *dst, struct list *src, struct file *from,
+		struct file *to);
+void vma_clear (struct list *vmas);
+
+#endif /* vm/vma.h */
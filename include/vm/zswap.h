@@ -0,0 +1,30 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+
+/* Compressed cache of swapped-out anonymous pages, kept in the
+ * kernel pool ahead of the swap disk. */
+
+/* Result of zswap_store(). */
+enum zswap_result {
+	ZSWAP_STORED,               /* Page is now in the cache. */
+	ZSWAP_INCOMPRESSIBLE,       /* Page does not compress well enough. */
+	ZSWAP_FULL                  /* Cache has no room for the page. */
+};
+
+/* Most kernel pages that the cache may use.  0 disables it. */
+extern size_t zswap_page_limit;
+
+void zswap_init (void);
+enum zswap_result zswap_store (struct page *page, const void *kva);
+void zswap_load (struct page *page, void *kva);
+bool zswap_copy (struct page *page, const struct page *from);
+void zswap_drop (struct page *page);
+size_t zswap_oldest (struct page *pages[], size_t cnt);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
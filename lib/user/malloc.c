@@ -0,0 +1,415 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A heap allocator for user programs.
+
+   The heap is one contiguous region obtained from sbrk().  It is
+   divided into "chunks", each starting with an 8-byte header that
+   holds the chunk's size, a multiple of 16, and two flag bits: one
+   saying whether the chunk is in use and one saying whether the
+   chunk just before it is.  A free chunk also stores its size in
+   its last 8 bytes (its "footer"), so that the chunk after it can
+   find it.  That lets free() merge a chunk with both neighbors
+   whenever they are free, which keeps the heap from fragmenting
+   into many small pieces.
+
+   Free chunks are kept in segregated lists, or "bins", by size:
+   one bin for each multiple of 16 below 512 bytes and one for
+   each power of 2 above.  malloc() takes the first chunk that
+   fits from the smallest suitable bin and splits off the part it
+   does not need.  When no chunk fits, the heap grows by at least
+   HEAP_GROW bytes, which costs little because the kernel only
+   backs pages with memory once they are touched.  When a free
+   chunk at the end of the heap grows past TRIM_THRESHOLD bytes,
+   its pages are returned to the kernel.
+
+   In front of the bins sits a cache of recently freed small
+   chunks, one short LIFO list per size class.  Chunks in the
+   cache still look allocated to the rest of the heap, so they
+   can be handed out again without any splitting or merging.
+   Allocators for multithreaded programs keep one such cache per
+   thread so that it needs no locking; a Pintos process has
+   exactly one thread, so there is exactly one cache. */
+
+/* Chunk header.  Only HEAD is valid in a chunk that is in use;
+   the links are valid in free chunks and in cached chunks. */
+struct chunk {
+	size_t head;                /* Size | CHUNK_INUSE | PREV_INUSE. */
+	struct chunk *next;         /* Next chunk in bin or cache. */
+	struct chunk *prev;         /* Previous chunk in bin. */
+};
+
+#define CHUNK_INUSE 1           /* This chunk is in use. */
+#define PREV_INUSE 2            /* The previous chunk is in use. */
+#define SIZE_MASK (~(size_t) 15)
+
+#define ALIGNMENT 16            /* Alignment of returned blocks. */
+#define OVERHEAD sizeof (size_t)        /* Bytes of header per chunk. */
+#define MIN_CHUNK 32            /* Room for header, links, footer. */
+#define MAX_REQUEST ((size_t) 1 << 40)  /* Larger requests fail. */
+
+#define SMALL_LIMIT 512         /* Smallest size with a ranged bin. */
+#define BIN_CNT 48              /* Number of bins. */
+
+#define CACHE_LIMIT 256         /* Largest chunk size cached. */
+#define CACHE_CLASSES (CACHE_LIMIT / ALIGNMENT - 1)
+#define CACHE_DEPTH 8           /* Chunks cached per size class. */
+
+#define HEAP_GROW (64 * 1024)   /* Minimum heap growth. */
+#define TRIM_THRESHOLD (128 * 1024)     /* Free top size to trim. */
+#define PAGE_SIZE 4096
+
+static struct chunk *bins[BIN_CNT];     /* Free chunks by size. */
+static struct chunk *cache[CACHE_CLASSES];      /* Cached chunks. */
+static unsigned cache_cnt[CACHE_CLASSES];       /* Chunks in each. */
+static char *heap_end;          /* Current end of the heap. */
+
+/* Returns the size of chunk C. */
+static inline size_t
+chunk_size (const struct chunk *c) {
+	return c->head & SIZE_MASK;
+}
+
+/* Returns the chunk that follows C in memory. */
+static inline struct chunk *
+next_chunk (const struct chunk *c) {
+	return (struct chunk *) ((char *) c + chunk_size (c));
+}
+
+/* Returns the chunk that precedes C in memory, which must be
+   free. */
+static inline struct chunk *
+prev_chunk (const struct chunk *c) {
+	size_t prev_size = *(const size_t *) ((const char *) c - OVERHEAD);
+	return (struct chunk *) ((char *) c - prev_size);
+}
+
+/* Returns the block handed out for chunk C, and vice versa. */
+static inline void *
+chunk_to_block (struct chunk *c) {
+	return (char *) c + OVERHEAD;
+}
+
+static inline struct chunk *
+block_to_chunk (void *p) {
+	return (struct chunk *) ((char *) p - OVERHEAD);
+}
+
+/* Returns the chunk size needed to satisfy a request for N
+   bytes. */
+static size_t
+request_size (size_t n) {
+	size_t size = ROUND_UP (n + OVERHEAD, ALIGNMENT);
+	return size < MIN_CHUNK ? MIN_CHUNK : size;
+}
+
+/* Returns the bin for free chunks of SIZE bytes. */
+static size_t
+bin_index (size_t size) {
+	size_t idx, bits;
+
+	if (size < SMALL_LIMIT)
+		return size / ALIGNMENT - MIN_CHUNK / ALIGNMENT;
+	for (bits = 0; ((size_t) SMALL_LIMIT << (bits + 1)) <= size; bits++)
+		continue;
+	idx = (SMALL_LIMIT - MIN_CHUNK) / ALIGNMENT + bits;
+	return idx < BIN_CNT ? idx : BIN_CNT - 1;
+}
+
+/* Adds free chunk C to its bin. */
+static void
+bin_insert (struct chunk *c) {
+	struct chunk **bin = &bins[bin_index (chunk_size (c))];
+
+	c->prev = NULL;
+	c->next = *bin;
+	if (*bin != NULL)
+		(*bin)->prev = c;
+	*bin = c;
+}
+
+/* Removes free chunk C from its bin. */
+static void
+bin_remove (struct chunk *c) {
+	if (c->prev != NULL)
+		c->prev->next = c->next;
+	else
+		bins[bin_index (chunk_size (c))] = c->next;
+	if (c->next != NULL)
+		c->next->prev = c->prev;
+}
+
+/* Marks C as a free chunk of SIZE bytes: sets its header and
+   footer and tells the chunk after it. */
+static void
+set_free (struct chunk *c, size_t size) {
+	c->head = size | (c->head & PREV_INUSE);
+	*(size_t *) ((char *) c + size - OVERHEAD) = size;
+	next_chunk (c)->head &= ~(size_t) PREV_INUSE;
+}
+
+/* Returns true if C is the zero-size chunk that ends the heap. */
+static inline bool
+is_heap_end (const struct chunk *c) {
+	return chunk_size (c) == 0;
+}
+
+/* Returns the pages at the end of free chunk C, which is the last
+   chunk in the heap, to the kernel.  Returns the chunk that is
+   left, or a null pointer if none is. */
+static struct chunk *
+trim_heap (struct chunk *c) {
+	size_t size = chunk_size (c);
+	size_t release = ROUND_DOWN (size, PAGE_SIZE);
+	struct chunk *end;
+
+	if (release != size && size - release < MIN_CHUNK)
+		release -= PAGE_SIZE;
+	if (release == 0 || sbrk (-(intptr_t) release) == (void *) -1)
+		return c;
+
+	heap_end -= release;
+	end = (struct chunk *) (heap_end - OVERHEAD);
+	if (release == size) {
+		end->head = CHUNK_INUSE | (c->head & PREV_INUSE);
+		return NULL;
+	}
+	end->head = CHUNK_INUSE;
+	set_free (c, size - release);
+	return c;
+}
+
+/* Marks in-use chunk C free and merges it with its free
+   neighbors, taking them out of their bins.  Returns the merged
+   chunk, which is in no bin. */
+static struct chunk *
+merge_chunk (struct chunk *c) {
+	size_t size = chunk_size (c);
+	struct chunk *next = next_chunk (c);
+
+	if (!(next->head & CHUNK_INUSE)) {
+		bin_remove (next);
+		size += chunk_size (next);
+	}
+	if (!(c->head & PREV_INUSE)) {
+		c = prev_chunk (c);
+		bin_remove (c);
+		size += chunk_size (c);
+	}
+	set_free (c, size);
+	return c;
+}
+
+/* Frees chunk C, merging it with free neighbors. */
+static void
+release_chunk (struct chunk *c) {
+	c = merge_chunk (c);
+	if (chunk_size (c) >= TRIM_THRESHOLD && is_heap_end (next_chunk (c)))
+		c = trim_heap (c);
+	if (c != NULL)
+		bin_insert (c);
+}
+
+/* Makes in-use chunk C exactly SIZE bytes long, if that leaves
+   enough for another chunk, and frees the rest. */
+static void
+shrink_chunk (struct chunk *c, size_t size) {
+	size_t total = chunk_size (c);
+	struct chunk *rest;
+
+	if (total - size < MIN_CHUNK)
+		return;
+	c->head = size | (c->head & ~SIZE_MASK);
+	rest = next_chunk (c);
+	rest->head = (total - size) | CHUNK_INUSE | PREV_INUSE;
+	release_chunk (rest);
+}
+
+/* Grows the heap by at least SIZE bytes and returns the free
+   chunk at its end, which is in no bin.  Returns a null pointer if
+   the kernel refuses. */
+static struct chunk *
+extend_heap (size_t size) {
+	size_t grow = ROUND_UP (size, PAGE_SIZE);
+	struct chunk *c;
+	char *p;
+
+	if (heap_end == NULL) {
+		/* Start the heap so that chunks sit 8 bytes below a
+		   16-byte boundary, which aligns the blocks. */
+		char *start = sbrk (0);
+		size_t pad = ROUND_UP ((uintptr_t) start + OVERHEAD, ALIGNMENT)
+			- (uintptr_t) start;
+
+		if (start == (void *) -1 || sbrk (pad) != start)
+			return NULL;
+		heap_end = start + pad;
+		c = (struct chunk *) (heap_end - OVERHEAD);
+		c->head = CHUNK_INUSE | PREV_INUSE;
+	}
+
+	if (grow < HEAP_GROW)
+		grow = HEAP_GROW;
+	p = sbrk (grow);
+	if (p == (void *) -1 && grow > size) {
+		grow = ROUND_UP (size, ALIGNMENT);
+		p = sbrk (grow);
+	}
+	/* Someone else moving the break would leave a hole. */
+	if (p == (void *) -1)
+		return NULL;
+	ASSERT (p == heap_end);
+
+	/* The old end-of-heap marker becomes the new chunk's header. */
+	c = (struct chunk *) (heap_end - OVERHEAD);
+	heap_end += grow;
+	((struct chunk *) (heap_end - OVERHEAD))->head = CHUNK_INUSE;
+	c->head = grow | (c->head & PREV_INUSE) | CHUNK_INUSE;
+	return merge_chunk (c);
+}
+
+/* Removes and returns a free chunk of at least SIZE bytes from
+   the bins, or returns a null pointer if there is none. */
+static struct chunk *
+find_fit (size_t size) {
+	size_t idx;
+
+	for (idx = bin_index (size); idx < BIN_CNT; idx++) {
+		struct chunk *c;
+		for (c = bins[idx]; c != NULL; c = c->next)
+			if (chunk_size (c) >= size) {
+				bin_remove (c);
+				return c;
+			}
+	}
+	return NULL;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t n) {
+	struct chunk *c;
+	size_t size;
+
+	if (n == 0 || n > MAX_REQUEST)
+		return NULL;
+	size = request_size (n);
+
+	/* Try the cache first. */
+	if (size <= CACHE_LIMIT) {
+		size_t cls = size / ALIGNMENT - MIN_CHUNK / ALIGNMENT;
+		if (cache[cls] != NULL) {
+			c = cache[cls];
+			cache[cls] = c->next;
+			cache_cnt[cls]--;
+			return chunk_to_block (c);
+		}
+	}
+
+	c = find_fit (size);
+	if (c == NULL) {
+		c = extend_heap (size);
+		if (c == NULL)
+			return NULL;
+	}
+
+	c->head |= CHUNK_INUSE;
+	next_chunk (c)->head |= PREV_INUSE;
+	shrink_chunk (c, size);
+	return chunk_to_block (c);
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) {
+	void *p;
+	size_t size;
+
+	/* Calculate block size and make sure it fits in size_t. */
+	size = a * b;
+	if (a != 0 && size / a != b)
+		return NULL;
+
+	/* Allocate and zero memory. */
+	p = malloc (size);
+	if (p != NULL)
+		memset (p, 0, size);
+
+	return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving
+   it in the process.  If successful, returns the new block; on
+   failure, returns a null pointer.  A call with null OLD_BLOCK is
+   equivalent to malloc(NEW_SIZE).  A call with zero NEW_SIZE is
+   equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) {
+	struct chunk *c, *next;
+	size_t size;
+	void *new_block;
+
+	if (old_block == NULL)
+		return malloc (new_size);
+	if (new_size == 0) {
+		free (old_block);
+		return NULL;
+	}
+	if (new_size > MAX_REQUEST)
+		return NULL;
+
+	c = block_to_chunk (old_block);
+	size = request_size (new_size);
+
+	/* Grow in place into a free neighbor, if there is one. */
+	next = next_chunk (c);
+	if (chunk_size (c) < size && !(next->head & CHUNK_INUSE)
+			&& chunk_size (c) + chunk_size (next) >= size) {
+		bin_remove (next);
+		c->head += chunk_size (next);
+		next_chunk (c)->head |= PREV_INUSE;
+	}
+	if (chunk_size (c) >= size) {
+		shrink_chunk (c, size);
+		return old_block;
+	}
+
+	new_block = malloc (new_size);
+	if (new_block != NULL) {
+		memcpy (new_block, old_block, chunk_size (c) - OVERHEAD);
+		free (old_block);
+	}
+	return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) {
+	struct chunk *c;
+	size_t size;
+
+	if (p == NULL)
+		return;
+
+	c = block_to_chunk (p);
+	size = chunk_size (c);
+	ASSERT (c->head & CHUNK_INUSE);
+
+	if (size <= CACHE_LIMIT) {
+		size_t cls = size / ALIGNMENT - MIN_CHUNK / ALIGNMENT;
+		if (cache_cnt[cls] < CACHE_DEPTH) {
+			c->next = cache[cls];
+			cache[cls] = c;
+			cache_cnt[cls]++;
+			return;
+		}
+	}
+	release_chunk (c);
+}
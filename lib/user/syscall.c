@@ -56,7 +56,7 @@ static __inline int64_t syscall (uint64_t num_, uint64_t a1_, uint64_t a2_,
 			((uint64_t) ARG2), 0, 0, 0))
 
 #define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3) ( \
-		syscall(((uint64_t *) NUMBER), \
+		syscall(((uint64_t) NUMBER), \
 			((uint64_t) ARG0), \
 			((uint64_t) ARG1), \
 			((uint64_t) ARG2), \
@@ -157,6 +157,69 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+bool
+get_memstat (struct memstat *st) {
+	return syscall1 (SYS_MEMSTAT, st);
+}
+
+bool
+get_procstat (struct procstat *st) {
+	return syscall1 (SYS_PROCSTAT, st);
+}
+
+bool
+get_faultstat (struct faultstat *st) {
+	return syscall1 (SYS_FAULTSTAT, st);
+}
+
+/* Sets the end of the heap to ADDR.  Returns 0 if successful,
+   -1 otherwise. */
+int
+brk (void *addr) {
+	return (void *) syscall1 (SYS_BRK, addr) == addr ? 0 : -1;
+}
+
+/* Moves the end of the heap by INCREMENT bytes, which may be
+   negative.  Returns the old end of the heap, or (void *) -1 on
+   failure. */
+void *
+sbrk (intptr_t increment) {
+	char *old_end = (char *) syscall1 (SYS_BRK, NULL);
+
+	if (increment != 0 && brk (old_end + increment) != 0)
+		return (void *) -1;
+	return old_end;
+}
+
+/* Advises the kernel that the LENGTH bytes at ADDR, which must be
+   page-aligned, will be used as ADVICE says, one of the MADV_*
+   values in <madvise.h>.  Returns 0 if successful, -1 otherwise. */
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+/* Writes back the pages of the file mappings in the LENGTH bytes at
+   ADDR, which must be page-aligned, that have been written since.
+   FLAGS is MS_SYNC or MS_ASYNC from <msync.h>.  Returns 0 if
+   successful, -1 otherwise. */
+int
+msync (void *addr, size_t length, int flags) {
+	return syscall3 (SYS_MSYNC, addr, length, flags);
+}
+
+/* Starts a new process running the executable FILE with the null-
+   terminated argument vector ARGV, whose first element is the program
+   name, without copying the caller's memory as fork() does.  The
+   child's file descriptors are a copy of the caller's, changed by the
+   ACTION_CNT ACTIONS from <spawn.h>.  Returns the child's pid, or
+   PID_ERROR if it could not be loaded or an action failed. */
+pid_t
+spawn (const char *file, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt) {
+	return (pid_t) syscall4 (SYS_SPAWN, file, argv, actions, action_cnt);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
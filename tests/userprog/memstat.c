@@ -0,0 +1,37 @@
+/* Retrieves the kernel memory statistics and checks that they
+   are consistent. */
+
+#include <memstat.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct memstat st;
+
+void
+test_main (void) 
+{
+  uint64_t tagged = 0;
+  size_t i;
+
+  CHECK (get_memstat (&st), "get_memstat");
+
+  CHECK (st.kernel_pool.used_pages <= st.kernel_pool.total_pages,
+         "kernel pool used pages within pool");
+  CHECK (st.user_pool.used_pages <= st.user_pool.total_pages,
+         "user pool used pages within pool");
+  CHECK (st.tag_pages[MEM_THREAD] > 0, "thread pages accounted");
+  CHECK (st.tag_pages[MEM_PAGETABLE] > 0, "page table pages accounted");
+
+  for (i = 0; i < MEM_TAG_CNT; i++)
+    tagged += st.tag_pages[i];
+  CHECK (tagged <= st.kernel_pool.used_pages + st.user_pool.used_pages,
+         "tagged pages within used pages");
+
+  CHECK (st.desc_cnt > 0 && st.desc_cnt <= MEMSTAT_DESC_CNT,
+         "malloc descriptors reported");
+  for (i = 1; i < st.desc_cnt; i++)
+    if (st.descs[i].block_size != 2 * st.descs[i - 1].block_size)
+      fail ("descriptor %zu has block size %llu", i,
+            st.descs[i].block_size);
+}
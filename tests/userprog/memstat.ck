@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(memstat) begin
+(memstat) get_memstat
+(memstat) kernel pool used pages within pool
+(memstat) user pool used pages within pool
+(memstat) thread pages accounted
+(memstat) page table pages accounted
+(memstat) tagged pages within used pages
+(memstat) malloc descriptors reported
+(memstat) end
+memstat: exit(0)
+EOF
+pass;
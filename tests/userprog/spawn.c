@@ -0,0 +1,27 @@
+/* Starts a subprocess with spawn(), without forking first, and waits
+   for it.  Then checks that spawn() fails for a missing executable
+   and for a file descriptor action on a descriptor out of range. */
+
+#include <spawn.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char *argv[] = { "child-simple", NULL };
+  struct spawn_action bad = { .op = SPAWN_CLOSE, .fd = -1 };
+  pid_t pid;
+
+  pid = spawn ("child-simple", argv, NULL, 0);
+  if (pid == PID_ERROR)
+    fail ("spawn failed");
+  msg ("wait(spawn()) = %d", wait (pid));
+
+  argv[0] = "no-such-file";
+  msg ("spawn(\"no-such-file\"): %d", spawn ("no-such-file", argv, NULL, 0));
+
+  argv[0] = "child-simple";
+  msg ("spawn with bad action: %d", spawn ("child-simple", argv, &bad, 1));
+}
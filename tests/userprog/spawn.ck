@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF', <<'EOF']);
+(spawn) begin
+(child-simple) run
+child-simple: exit(81)
+(spawn) wait(spawn()) = 81
+load: no-such-file: open failed
+(spawn) spawn("no-such-file"): -1
+(spawn) spawn with bad action: -1
+(spawn) end
+spawn: exit(0)
+EOF
+(spawn) begin
+(child-simple) run
+child-simple: exit(81)
+(spawn) wait(spawn()) = 81
+(spawn) spawn("no-such-file"): -1
+(spawn) spawn with bad action: -1
+(spawn) end
+spawn: exit(0)
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Child process of pff-bench.
+   With argument "sweep", writes through a buffer larger than the
+   user pool several times.  With argument "hot", keeps rewriting a
+   small buffer and exits with the number of page faults it took. */
+
+#include <memstat.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SWEEP_SIZE (3 * 1024 * 1024)
+#define SWEEP_CNT 4
+#define HOT_SIZE (64 * 1024)
+#define HOT_CNT 2000
+
+static char sweep_buf[SWEEP_SIZE];
+static char hot_buf[HOT_SIZE];
+
+static int
+sweep (void)
+{
+  size_t i;
+  int round;
+
+  for (round = 0; round < SWEEP_CNT; round++)
+    for (i = 0; i < SWEEP_SIZE; i += PAGE_SIZE)
+      sweep_buf[i] = round;
+  for (i = 0; i < SWEEP_SIZE; i += PAGE_SIZE)
+    if (sweep_buf[i] != SWEEP_CNT - 1)
+      fail ("sweep byte %zu is %d", i, sweep_buf[i]);
+  return 0x42;
+}
+
+static int
+hot (void)
+{
+  struct procstat st;
+  size_t i;
+  int round;
+
+  for (round = 0; round < HOT_CNT; round++)
+    for (i = 0; i < HOT_SIZE; i += PAGE_SIZE)
+      {
+        if (round > 0 && hot_buf[i] != (char) (round - 1))
+          fail ("hot byte %zu is %d", i, hot_buf[i]);
+        hot_buf[i] = round;
+      }
+  if (!get_procstat (&st))
+    fail ("get_procstat failed");
+  return st.fault_cnt;
+}
+
+int
+main (int argc, char *argv[])
+{
+  test_name = "child-pff";
+
+  if (argc != 2)
+    fail ("usage: child-pff sweep|hot");
+  if (!strcmp (argv[1], "sweep"))
+    return sweep ();
+  if (!strcmp (argv[1], "hot"))
+    return hot ();
+  fail ("unknown mode %s", argv[1]);
+}
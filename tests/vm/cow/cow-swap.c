@@ -0,0 +1,57 @@
+/* Fills a buffer larger than the user pool, then forks.  Fork shares
+   every page of the buffer between the two processes, so from then on
+   memory can only be found by evicting shared frames.  Both processes
+   then check the whole buffer. */
+
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define BUF_SIZE (16 * 1024 * 1024)
+#define PAGE_CNT (BUF_SIZE / PAGE_SIZE)
+#define WORDS (PAGE_SIZE / sizeof (uint32_t))
+
+static uint32_t buf[BUF_SIZE / sizeof (uint32_t)];
+
+/* Checks that every page of BUF holds its page number at its start
+   and the complement at its end. */
+static void
+check_buf (const char *who)
+{
+  size_t pg;
+
+  for (pg = 0; pg < PAGE_CNT; pg++)
+    {
+      uint32_t *p = buf + pg * WORDS;
+
+      if (p[0] != pg || p[WORDS - 1] != ~pg)
+        fail ("%s: page %zu has wrong contents", who, pg);
+    }
+  msg ("%s: buffer intact", who);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t pg;
+
+  for (pg = 0; pg < PAGE_CNT; pg++)
+    {
+      buf[pg * WORDS] = pg;
+      buf[pg * WORDS + WORDS - 1] = ~pg;
+    }
+  msg ("buffer filled");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      check_buf ("child");
+      return;
+    }
+  CHECK (child > 0, "fork");
+  CHECK (wait (child) == 0, "wait for child");
+  check_buf ("parent");
+}
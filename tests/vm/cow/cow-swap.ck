@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(cow-swap) begin
+(cow-swap) buffer filled
+(cow-swap) child: buffer intact
+(cow-swap) end
+(cow-swap) fork
+(cow-swap) wait for child
+(cow-swap) parent: buffer intact
+(cow-swap) end
+EOF
+pass;
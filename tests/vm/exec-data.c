@@ -0,0 +1,62 @@
+/* Reads a writable, initialized data array that spans several pages,
+   which is backed by the executable until written, then writes one
+   of its pages and checks that the others still hold their initial
+   contents.  A forked child then writes another page, which must not
+   change the parent's copy. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+/* Initialized, so that it lives in the data segment, not BSS.  Each
+   page starts with its number plus 1 and ends with 0x5a. */
+static char data[PAGE_CNT * PAGE_SIZE] = {
+  [0 * PAGE_SIZE] = 1, [1 * PAGE_SIZE - 1] = 0x5a,
+  [1 * PAGE_SIZE] = 2, [2 * PAGE_SIZE - 1] = 0x5a,
+  [2 * PAGE_SIZE] = 3, [3 * PAGE_SIZE - 1] = 0x5a,
+  [3 * PAGE_SIZE] = 4, [4 * PAGE_SIZE - 1] = 0x5a,
+};
+
+/* Checks that page PG of DATA holds its initial contents. */
+static void
+check_page (size_t pg)
+{
+  char *p = data + pg * PAGE_SIZE;
+
+  if (p[0] != (char) (pg + 1) || p[PAGE_SIZE - 1] != 0x5a)
+    fail ("page %zu has wrong contents", pg);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    check_page (i);
+  msg ("initial data intact");
+
+  memset (data + PAGE_SIZE, 0xcc, PAGE_SIZE);
+  for (i = 0; i < PAGE_CNT; i++)
+    if (i != 1)
+      check_page (i);
+  if (data[PAGE_SIZE] != (char) 0xcc
+      || data[2 * PAGE_SIZE - 1] != (char) 0xcc)
+    fail ("written page lost its contents");
+  msg ("written page private");
+
+  child = fork ("child");
+  if (child == 0)
+    {
+      memset (data + 2 * PAGE_SIZE, 0x33, PAGE_SIZE);
+      exit (data[2 * PAGE_SIZE] == 0x33 ? 0x42 : 0);
+    }
+  CHECK (wait (child) == 0x42, "wait for child");
+  check_page (2);
+  msg ("child's write not seen");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(exec-data) begin
+(exec-data) initial data intact
+(exec-data) written page private
+(exec-data) wait for child
+(exec-data) child's write not seen
+(exec-data) end
+EOF
+pass;
@@ -0,0 +1,77 @@
+/* Touches fresh heap pages and checks the page faults that it costs,
+   as reported by the int 0x43 inspect interrupt, get_procstat() and
+   get_faultstat(): one minor zero-fill fault per page written, none
+   for reading them back. */
+
+#include <memstat.h>
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 16
+
+/* Returns the faults of CLASS that this process has taken, or its
+   major faults if CLASS is FAULT_CLASS_CNT. */
+static uint64_t
+fault_count (uint64_t class)
+{
+  uint64_t cnt;
+
+  asm volatile ("int $0x43" : "=a" (cnt) : "a" (class) : "memory");
+  return cnt;
+}
+
+void
+test_main (void)
+{
+  static struct procstat before, after;
+  static struct faultstat fs;
+  uint64_t zero, major, total;
+  char *start, *heap;
+  size_t i, j;
+
+  start = sbrk (0);
+  heap = (char *) (((uintptr_t) start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+  CHECK (sbrk (heap - start + PAGE_CNT * PAGE_SIZE) == start,
+         "grow heap by %d pages", PAGE_CNT);
+
+  CHECK (get_procstat (&before), "get_procstat");
+  zero = fault_count (FAULT_ZERO);
+  major = fault_count (FAULT_CLASS_CNT);
+  for (i = 0; i < PAGE_CNT; i++)
+    heap[i * PAGE_SIZE] = i;
+  for (i = 0; i < PAGE_CNT; i++)
+    if (heap[i * PAGE_SIZE] != (char) i)
+      fail ("page %zu has the wrong contents", i);
+  if (fault_count (FAULT_ZERO) - zero != PAGE_CNT)
+    fail ("%llu zero-fill faults for %d pages",
+          fault_count (FAULT_ZERO) - zero, PAGE_CNT);
+  if (fault_count (FAULT_CLASS_CNT) != major)
+    fail ("zero-fill pages took major faults");
+  msg ("one zero-fill fault per page");
+
+  CHECK (get_procstat (&after), "get_procstat");
+  if (after.minor_cnt - before.minor_cnt < PAGE_CNT)
+    fail ("%llu minor faults counted for %d pages",
+          after.minor_cnt - before.minor_cnt, PAGE_CNT);
+  if (after.class_cnt[FAULT_ZERO] != fault_count (FAULT_ZERO))
+    fail ("get_procstat and int 0x43 disagree");
+  msg ("process counters match");
+
+  CHECK (get_faultstat (&fs), "get_faultstat");
+  for (i = 0; i < FAULT_CLASS_CNT; i++)
+    {
+      total = 0;
+      for (j = 0; j < FAULT_HIST_CNT; j++)
+        total += fs.classes[i].hist[j];
+      if (total != fs.classes[i].cnt)
+        fail ("class %zu histogram does not add up", i);
+    }
+  if (fs.classes[FAULT_ZERO].cnt < PAGE_CNT)
+    fail ("system counted %llu zero-fill faults",
+          fs.classes[FAULT_ZERO].cnt);
+  msg ("system histograms add up");
+}
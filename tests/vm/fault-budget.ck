@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-budget) begin
+(fault-budget) grow heap by 16 pages
+(fault-budget) get_procstat
+(fault-budget) one zero-fill fault per page
+(fault-budget) get_procstat
+(fault-budget) process counters match
+(fault-budget) get_faultstat
+(fault-budget) system histograms add up
+(fault-budget) end
+EOF
+pass;
@@ -0,0 +1,55 @@
+/* Checks madvise() on heap pages: MADV_POPULATE loads them,
+   MADV_DONTNEED discards their contents, the access pattern hints
+   are accepted, and bad requests are refused. */
+
+#include <madvise.h>
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+void
+test_main (void)
+{
+  char *start, *heap;
+  size_t i;
+
+  start = sbrk (0);
+  heap = (char *) (((uintptr_t) start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+  CHECK (sbrk (heap - start + PAGE_CNT * PAGE_SIZE) == start,
+         "grow heap by %d pages", PAGE_CNT);
+
+  CHECK (madvise (heap, PAGE_CNT * PAGE_SIZE, MADV_POPULATE) == 0,
+         "populate heap");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (get_phys_addr (heap + i * PAGE_SIZE) == 0)
+      fail ("page %zu not loaded", i);
+  msg ("heap pages loaded");
+
+  memset (heap, 0x5a, PAGE_CNT * PAGE_SIZE);
+  CHECK (madvise (heap, PAGE_CNT * PAGE_SIZE, MADV_DONTNEED) == 0,
+         "drop heap");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (get_phys_addr (heap + i * PAGE_SIZE) != 0)
+      fail ("page %zu still loaded", i);
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    if (heap[i] != 0)
+      fail ("byte %zu is nonzero", i);
+  msg ("dropped pages read back as zero");
+
+  CHECK (madvise (heap, PAGE_CNT * PAGE_SIZE, MADV_SEQUENTIAL) == 0,
+         "advise sequential");
+  CHECK (madvise (heap, PAGE_CNT * PAGE_SIZE, MADV_RANDOM) == 0,
+         "advise random");
+  CHECK (madvise (heap, PAGE_CNT * PAGE_SIZE, MADV_WILLNEED) == 0,
+         "advise willneed");
+  CHECK (madvise (heap + 1, PAGE_SIZE, MADV_NORMAL) == -1,
+         "misaligned address refused");
+  CHECK (madvise (heap, PAGE_SIZE, 42) == -1, "unknown advice refused");
+  CHECK (madvise (heap, (PAGE_CNT + 1) * PAGE_SIZE, MADV_NORMAL) == -1,
+         "unmapped range refused");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) grow heap by 4 pages
+(madvise) populate heap
+(madvise) heap pages loaded
+(madvise) drop heap
+(madvise) dropped pages read back as zero
+(madvise) advise sequential
+(madvise) advise random
+(madvise) advise willneed
+(madvise) misaligned address refused
+(madvise) unknown advice refused
+(madvise) unmapped range refused
+(madvise) end
+EOF
+pass;
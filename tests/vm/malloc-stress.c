@@ -0,0 +1,98 @@
+/* Allocates, resizes and frees blocks of random sizes, keeping a
+   pattern in each live block, and checks that no block is ever
+   corrupted or misaligned. */
+
+#include <malloc.h>
+#include <random.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SLOT_CNT 256
+#define ROUND_CNT 20000
+
+static unsigned char *blocks[SLOT_CNT];
+static size_t sizes[SLOT_CNT];
+
+/* Returns a random request size, mostly small. */
+static size_t
+random_size (void)
+{
+  if (random_ulong () % 16 == 0)
+    return random_ulong () % (64 * 1024) + 1;
+  return random_ulong () % 300 + 1;
+}
+
+static void
+fill (size_t slot)
+{
+  size_t i;
+
+  if ((uintptr_t) blocks[slot] % 16 != 0)
+    fail ("block %p is misaligned", blocks[slot]);
+  for (i = 0; i < sizes[slot]; i++)
+    blocks[slot][i] = slot + i;
+}
+
+static void
+verify (size_t slot, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (blocks[slot][i] != (unsigned char) (slot + i))
+      fail ("block %zu corrupted at byte %zu", slot, i);
+}
+
+void
+test_main (void)
+{
+  size_t round, slot;
+
+  random_init (0);
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      slot = random_ulong () % SLOT_CNT;
+      if (blocks[slot] == NULL)
+        {
+          sizes[slot] = random_size ();
+          blocks[slot] = malloc (sizes[slot]);
+          if (blocks[slot] == NULL)
+            fail ("malloc (%zu) failed", sizes[slot]);
+          fill (slot);
+        }
+      else if (random_ulong () % 2 == 0)
+        {
+          size_t size = random_size ();
+          unsigned char *p = realloc (blocks[slot], size);
+          if (p == NULL)
+            fail ("realloc (%zu) failed", size);
+          blocks[slot] = p;
+          verify (slot, size < sizes[slot] ? size : sizes[slot]);
+          sizes[slot] = size;
+          fill (slot);
+        }
+      else
+        {
+          verify (slot, sizes[slot]);
+          free (blocks[slot]);
+          blocks[slot] = NULL;
+        }
+    }
+  msg ("%d rounds of malloc, realloc and free", ROUND_CNT);
+
+  for (slot = 0; slot < SLOT_CNT; slot++)
+    {
+      if (blocks[slot] != NULL)
+        verify (slot, sizes[slot]);
+      free (blocks[slot]);
+    }
+  msg ("all blocks intact");
+
+  blocks[0] = calloc (1000, 8);
+  CHECK (blocks[0] != NULL, "calloc");
+  for (slot = 0; slot < 8000; slot++)
+    if (blocks[0][slot] != 0)
+      fail ("calloc'd byte %zu is nonzero", slot);
+  free (blocks[0]);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(malloc-stress) begin
+(malloc-stress) 20000 rounds of malloc, realloc and free
+(malloc-stress) all blocks intact
+(malloc-stress) calloc
+(malloc-stress) end
+EOF
+pass;
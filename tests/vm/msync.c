@@ -0,0 +1,46 @@
+/* Writes to a file through a mapping and checks that msync()
+   makes the data visible to read() while the file is still mapped,
+   and that bad requests are refused. */
+
+#include <msync.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((void *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+  void *map;
+  char buf[1024];
+
+  CHECK (create ("sample.txt", strlen (sample)), "create \"sample.txt\"");
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (ACTUAL, 4096, 1, handle, 0)) != MAP_FAILED,
+         "mmap \"sample.txt\"");
+  memcpy (ACTUAL, sample, strlen (sample));
+
+  CHECK (msync (map, 4096, MS_SYNC) == 0, "msync MS_SYNC");
+  read (handle, buf, strlen (sample));
+  CHECK (!memcmp (buf, sample, strlen (sample)),
+         "compare read data against written data");
+
+  memset (ACTUAL, 'x', 16);
+  CHECK (msync (map, 4096, MS_ASYNC) == 0, "msync MS_ASYNC");
+  CHECK (msync (map, 4096, MS_SYNC | MS_ASYNC) == -1,
+         "conflicting flags refused");
+  CHECK (msync ((char *) map + 1, 4096, MS_SYNC) == -1,
+         "misaligned address refused");
+  CHECK (msync (map, 2 * 4096, MS_SYNC) == -1, "unmapped range refused");
+
+  munmap (map);
+  seek (handle, 0);
+  read (handle, buf, 16);
+  CHECK (!memcmp (buf, "xxxxxxxxxxxxxxxx", 16),
+         "unmap writes back the second write");
+  close (handle);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(msync) begin
+(msync) create "sample.txt"
+(msync) open "sample.txt"
+(msync) mmap "sample.txt"
+(msync) msync MS_SYNC
+(msync) compare read data against written data
+(msync) msync MS_ASYNC
+(msync) conflicting flags refused
+(msync) misaligned address refused
+(msync) unmapped range refused
+(msync) unmap writes back the second write
+(msync) end
+EOF
+pass;
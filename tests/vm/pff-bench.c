@@ -0,0 +1,44 @@
+/* Runs HOT_CNT child-pff processes that keep rewriting a small
+   working set next to one that sweeps through more memory than the
+   user pool holds, and reports the page faults that the small ones
+   take.  With page-fault-frequency frame quotas, the sweeper mostly
+   evicts its own pages; boot with -no-pff to compare with one global
+   clock. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define HOT_CNT 3
+
+static pid_t
+spawn_child (const char *cmd)
+{
+  pid_t pid = fork ("child-pff");
+
+  if (pid == 0 && exec (cmd) == -1)
+    fail ("failed to exec %s", cmd);
+  return pid;
+}
+
+void
+test_main (void)
+{
+  pid_t sweeper, children[HOT_CNT];
+  int faults = 0;
+  int i;
+
+  sweeper = spawn_child ("child-pff sweep");
+  for (i = 0; i < HOT_CNT; i++)
+    children[i] = spawn_child ("child-pff hot");
+
+  for (i = 0; i < HOT_CNT; i++)
+    {
+      int status = wait (children[i]);
+      if (status < 0)
+        fail ("hot child %d failed", i);
+      faults += status;
+    }
+  CHECK (wait (sweeper) == 0x42, "wait for sweeper");
+  msg ("hot processes: %d page faults", faults);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing 'wait for sweeper' message\n"
+  if !grep ($_ eq '(pff-bench) wait for sweeper', @output);
+fail "missing page fault count\n"
+  if !grep (/^\(pff-bench\) hot processes: \d+ page faults$/, @output);
+pass;
@@ -0,0 +1,62 @@
+/* Grows the heap one page past each of several 2 MB boundaries,
+   touching that page, so that each needs a page table of its own,
+   then shrinks the heap back.  The page tables must be freed as
+   they empty, over several rounds, rather than pile up until
+   exit. */
+
+#include <memstat.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define TABLE_CNT 8
+#define ROUND_CNT 3
+
+/* Returns the number of pages that our page tables take. */
+static uint64_t
+table_pages (void)
+{
+  struct procstat ps;
+
+  if (!get_procstat (&ps))
+    fail ("get_procstat failed");
+  return ps.pagetable_pages;
+}
+
+void
+test_main (void)
+{
+  char *start = sbrk (0);
+  char *base = (char *) (((uintptr_t) start + HUGE_SIZE - 1)
+                         & ~(uintptr_t) (HUGE_SIZE - 1));
+  uint64_t baseline = table_pages ();
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      /* The heap ends just past each page touched, so none of
+         them can be mapped by a 2 MB page. */
+      for (i = 1; i <= TABLE_CNT; i++)
+        {
+          volatile char *p = base + i * HUGE_SIZE;
+
+          if (brk ((char *) p + PAGE_SIZE) != 0)
+            fail ("brk failed");
+          if (*p != 0)
+            fail ("new heap page is nonzero");
+        }
+      if (table_pages () < baseline + TABLE_CNT)
+        fail ("%llu page table pages, expected at least %llu",
+              table_pages (), baseline + TABLE_CNT);
+
+      if (brk (start) != 0)
+        fail ("brk failed");
+      if (table_pages () != baseline)
+        fail ("%llu page table pages after shrinking, expected %llu",
+              table_pages (), baseline);
+    }
+  msg ("page tables reclaimed over %d rounds", ROUND_CNT);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pt-reclaim) begin
+(pt-reclaim) page tables reclaimed over 3 rounds
+(pt-reclaim) end
+EOF
+pass;
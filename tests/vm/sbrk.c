@@ -0,0 +1,43 @@
+/* Grows the heap with sbrk(), checks that the new pages are
+   zeroed and only brought in when touched, then shrinks it again
+   and checks that bad breaks are refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 4
+
+void
+test_main (void)
+{
+  char *start, *end;
+  size_t i;
+
+  start = sbrk (0);
+  CHECK (start != (void *) -1, "sbrk (0)");
+  end = (char *) (((uintptr_t) start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+  CHECK (sbrk (end - start + PAGE_CNT * PAGE_SIZE) == start,
+         "grow heap by %d pages", PAGE_CNT);
+
+  for (i = 0; i < PAGE_CNT; i++)
+    if (get_phys_addr (end + i * PAGE_SIZE) != 0)
+      fail ("page %zu loaded before use", i);
+  msg ("new pages not loaded");
+
+  for (i = 0; i < PAGE_CNT * PAGE_SIZE; i++)
+    if (end[i] != 0)
+      fail ("byte %zu is nonzero", i);
+  memset (end, 0x5a, PAGE_CNT * PAGE_SIZE);
+  msg ("new pages zeroed and writable");
+
+  CHECK (sbrk (-PAGE_CNT * PAGE_SIZE) == end + PAGE_CNT * PAGE_SIZE,
+         "shrink heap");
+  CHECK (sbrk (0) == end, "break moved back");
+  CHECK (brk (start - PAGE_SIZE) == -1, "break below heap refused");
+  CHECK (brk ((void *) 0x47480000) == -1, "break into stack refused");
+  CHECK (sbrk (0) == end, "break unchanged");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk (0)
+(sbrk) grow heap by 4 pages
+(sbrk) new pages not loaded
+(sbrk) new pages zeroed and writable
+(sbrk) shrink heap
+(sbrk) break moved back
+(sbrk) break below heap refused
+(sbrk) break into stack refused
+(sbrk) break unchanged
+(sbrk) end
+EOF
+pass;
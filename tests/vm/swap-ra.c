@@ -0,0 +1,79 @@
+/* Fills pages of a buffer larger than the user pool with data that
+   does not compress, so that most of them go to the swap disk in
+   order, then reads them back in order, then backward, and checks
+   their contents.  Swap readahead should bring most of them back in
+   runs, so the forward pass must read at least two pages from swap
+   per major fault; a page read ahead must not be mistaken for a fresh
+   one. */
+
+#include <memstat.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ONE_MB (1 << 20)
+#define BUF_SIZE (16 * ONE_MB)
+#define PAGE_CNT (BUF_SIZE / PAGE_SIZE)
+
+static uint32_t buf[BUF_SIZE / sizeof (uint32_t)];
+
+/* Returns word I of page PG's pattern. */
+static uint32_t
+pattern (size_t pg, size_t i)
+{
+  uint32_t x = pg * 2654435761u + i * 40503u + 1;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+/* Checks that page PG holds its pattern. */
+static void
+check_page (size_t pg)
+{
+  uint32_t *p = buf + pg * (PAGE_SIZE / sizeof *p);
+  size_t i;
+
+  for (i = 0; i < PAGE_SIZE / sizeof *p; i++)
+    if (p[i] != pattern (pg, i))
+      fail ("page %zu has wrong contents", pg);
+}
+
+void
+test_main (void)
+{
+  struct procstat before, after;
+  unsigned long long swap_in_cnt, major_cnt;
+  size_t pg, i;
+
+  for (pg = 0; pg < PAGE_CNT; pg++)
+    {
+      uint32_t *p = buf + pg * (PAGE_SIZE / sizeof *p);
+
+      for (i = 0; i < PAGE_SIZE / sizeof *p; i++)
+        p[i] = pattern (pg, i);
+    }
+  msg ("buffer filled");
+
+  CHECK (get_procstat (&before), "get_procstat");
+  for (pg = 0; pg < PAGE_CNT; pg++)
+    check_page (pg);
+  msg ("read forward");
+  CHECK (get_procstat (&after), "get_procstat");
+
+  for (pg = PAGE_CNT; pg-- > 0; )
+    check_page (pg);
+  msg ("read backward");
+
+  swap_in_cnt = after.swap_in_cnt - before.swap_in_cnt;
+  major_cnt = after.major_cnt - before.major_cnt;
+  if (major_cnt == 0)
+    fail ("no major faults reading forward");
+  if (swap_in_cnt < 2 * major_cnt)
+    fail ("%llu pages read from swap in %llu major faults reading forward",
+          swap_in_cnt, major_cnt);
+}
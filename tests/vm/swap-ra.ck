@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-ra) begin
+(swap-ra) buffer filled
+(swap-ra) get_procstat
+(swap-ra) read forward
+(swap-ra) get_procstat
+(swap-ra) read backward
+(swap-ra) end
+EOF
+pass;
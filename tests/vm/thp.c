@@ -0,0 +1,64 @@
+/* Fills a heap that spans two aligned 2 MB blocks, which may be
+   backed by huge pages, then frees parts of it with sbrk() and
+   MADV_DONTNEED, which split huge pages, and checks that the rest
+   of the data is intact and the freed page reads back as zero. */
+
+#include <madvise.h>
+#include <string.h>
+#include <syscall.h>
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define HUGE_SIZE (2 * 1024 * 1024)
+#define PAGE_CNT (2 * HUGE_SIZE / PAGE_SIZE)
+
+/* Checks that the pages of HEAP in [FIRST, LAST) hold their
+   pattern. */
+static void
+check_pages (char *heap, size_t first, size_t last)
+{
+  size_t i;
+
+  for (i = first; i < last; i++)
+    if (heap[i * PAGE_SIZE] != (char) i
+        || heap[i * PAGE_SIZE + PAGE_SIZE - 1] != (char) ~i)
+      fail ("page %zu has wrong contents", i);
+}
+
+void
+test_main (void)
+{
+  char *start, *heap;
+  size_t i;
+
+  start = sbrk (0);
+  heap = (char *) (((uintptr_t) start + HUGE_SIZE - 1) & ~(HUGE_SIZE - 1));
+  CHECK (sbrk (heap - start + PAGE_CNT * PAGE_SIZE) == start,
+         "grow heap over two aligned 2 MB blocks");
+
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      heap[i * PAGE_SIZE] = i;
+      heap[i * PAGE_SIZE + PAGE_SIZE - 1] = ~i;
+    }
+  check_pages (heap, 0, PAGE_CNT);
+  msg ("heap filled");
+
+  CHECK (sbrk (-(HUGE_SIZE / 2)) != (void *) -1,
+         "shrink heap by half a block");
+  check_pages (heap, 0, PAGE_CNT - HUGE_SIZE / 2 / PAGE_SIZE);
+  msg ("rest of second block intact");
+
+  CHECK (madvise (heap + 7 * PAGE_SIZE, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "drop one page of the first block");
+  for (i = 0; i < PAGE_SIZE; i++)
+    if (heap[7 * PAGE_SIZE + i] != 0)
+      fail ("byte %zu of dropped page is nonzero", i);
+  check_pages (heap, 0, 7);
+  check_pages (heap, 8, PAGE_CNT - HUGE_SIZE / 2 / PAGE_SIZE);
+  msg ("other pages intact");
+
+  CHECK (brk (start) == 0, "shrink heap back");
+}
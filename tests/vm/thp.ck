@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(thp) begin
+(thp) grow heap over two aligned 2 MB blocks
+(thp) heap filled
+(thp) shrink heap by half a block
+(thp) rest of second block intact
+(thp) drop one page of the first block
+(thp) other pages intact
+(thp) shrink heap back
+(thp) end
+EOF
+pass;
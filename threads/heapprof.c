@@ -0,0 +1,310 @@
+#include "threads/heapprof.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#ifdef HEAPPROF
+
+/* Allocation-site heap profiler.
+
+   Every allocation made through malloc() (and so calloc() and
+   realloc()) or palloc_get_multiple() is attributed to a "site",
+   the innermost SITE_DEPTH return addresses above the allocator.
+   Sites live in a hash table keyed by their call stack.  Each live
+   allocation is remembered in a second hash table, keyed by its
+   address, so that free() can find the site to credit.
+
+   Both tables are open-addressed with linear probing and are
+   allocated once at startup, so the profiler never calls the
+   allocators it watches.  When a table fills up, further sites are
+   folded into a catch-all site and further live allocations are
+   counted as dropped.
+
+   The tables are updated with interrupts off, since pages are freed
+   from within the scheduler. */
+
+#define SITE_DEPTH 4                    /* Return addresses per site. */
+#define SITE_BITS 9
+#define SITE_CNT (1 << SITE_BITS)       /* Entries in site table. */
+#define LIVE_BITS 13
+#define LIVE_CNT (1 << LIVE_BITS)       /* Entries in live table. */
+#define TOP_CNT 10                      /* Sites printed per ranking. */
+
+/* An allocation site. */
+struct site {
+	void *stack[SITE_DEPTH];            /* Call stack, null-padded. */
+	enum heapprof_kind kind;            /* Allocator. */
+	bool in_use;                        /* Entry is occupied. */
+	size_t live_bytes;                  /* Bytes currently allocated. */
+	size_t live_cnt;                    /* Blocks currently allocated. */
+	uint64_t alloc_cnt;                 /* Allocations ever made. */
+	uint64_t alloc_bytes;               /* Bytes ever allocated. */
+	int64_t first_tick;                 /* When first seen. */
+};
+
+/* A live allocation. */
+struct live {
+	void *ptr;                          /* Address, null if free entry. */
+	uint32_t size;                      /* Size in bytes. */
+	uint16_t site;                      /* Index into sites[]. */
+};
+
+static struct site *sites;              /* Site table. */
+static struct live *lives;              /* Live allocation table. */
+static size_t live_cnt;                 /* Occupied entries in lives[]. */
+static uint64_t dropped_cnt;            /* Allocations not tracked. */
+
+/* Site that collects allocations once sites[] is full. */
+#define OVERFLOW_SITE 0
+
+/* Sets up the profiler.  Must be called after the page allocator
+   is initialized.  Allocations made before are not tracked. */
+void
+heapprof_init (void) {
+	size_t site_pages = DIV_ROUND_UP (SITE_CNT * sizeof *sites, PGSIZE);
+	size_t live_pages = DIV_ROUND_UP (LIVE_CNT * sizeof *lives, PGSIZE);
+	struct site *s;
+
+	s = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, site_pages);
+	lives = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, live_pages);
+	s[OVERFLOW_SITE].in_use = true;
+
+	/* Tracking starts once SITES is set. */
+	sites = s;
+}
+
+/* Hashes the SITE_DEPTH words starting at STACK. */
+static unsigned
+hash_stack (void *stack[]) {
+	uint64_t h = 0;
+	for (int i = 0; i < SITE_DEPTH; i++)
+		h = (h ^ (uint64_t) stack[i]) * 0x9e3779b97f4a7c15ULL;
+	return h >> 32;
+}
+
+/* Hashes pointer P. */
+static unsigned
+hash_ptr (const void *p) {
+	return ((uint64_t) p * 0x9e3779b97f4a7c15ULL) >> (64 - LIVE_BITS);
+}
+
+/* Returns the index of the site for KIND and STACK, creating it if
+   necessary. */
+static size_t
+site_lookup (enum heapprof_kind kind, void *stack[]) {
+	size_t i = hash_stack (stack) & (SITE_CNT - 1);
+	size_t probes;
+
+	for (probes = 0; probes < SITE_CNT; probes++, i = (i + 1) & (SITE_CNT - 1)) {
+		struct site *s = &sites[i];
+		if (i == OVERFLOW_SITE)
+			continue;
+		if (!s->in_use) {
+			memcpy (s->stack, stack, sizeof s->stack);
+			s->kind = kind;
+			s->in_use = true;
+			s->first_tick = timer_ticks ();
+			return i;
+		}
+		if (s->kind == kind && !memcmp (s->stack, stack, sizeof s->stack))
+			return i;
+	}
+	return OVERFLOW_SITE;
+}
+
+/* Fills STACK with the return addresses of the SITE_DEPTH frames
+   above the allocator that called heapprof_alloc(). */
+static void
+capture_stack (void *stack[]) {
+	void **frame = __builtin_frame_address (0);
+	int skip = 2;               /* Into heapprof_alloc(), allocator. */
+	int i = 0;
+
+	for (; frame != NULL && frame[0] != NULL && i < SITE_DEPTH;
+			frame = frame[0])
+		if (skip-- <= 0)
+			stack[i++] = frame[1];
+	while (i < SITE_DEPTH)
+		stack[i++] = NULL;
+}
+
+/* Removes the entry for PTR from the live table and stores it in
+   *ENTRY.  Returns false if PTR was never recorded.  Interrupts
+   must be off. */
+static bool
+live_remove (void *ptr, struct live *entry) {
+	size_t i, j;
+
+	for (i = hash_ptr (ptr); lives[i].ptr != ptr; i = (i + 1) & (LIVE_CNT - 1))
+		if (lives[i].ptr == NULL)
+			return false;
+	*entry = lives[i];
+	live_cnt--;
+
+	/* Delete entry I by shifting back later entries of its probe
+	   sequence, so that no tombstones are needed. */
+	lives[i].ptr = NULL;
+	for (j = (i + 1) & (LIVE_CNT - 1); lives[j].ptr != NULL;
+			j = (j + 1) & (LIVE_CNT - 1)) {
+		size_t home = hash_ptr (lives[j].ptr);
+		bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+		if (movable) {
+			lives[i] = lives[j];
+			lives[j].ptr = NULL;
+			i = j;
+		}
+	}
+	return true;
+}
+
+/* Adds ENTRY to the live table, which must have room for it.
+   Interrupts must be off. */
+static void
+live_insert (const struct live *entry) {
+	size_t i;
+
+	for (i = hash_ptr (entry->ptr); lives[i].ptr != NULL;
+			i = (i + 1) & (LIVE_CNT - 1))
+		continue;
+	lives[i] = *entry;
+	live_cnt++;
+}
+
+/* Records that the allocator KIND handed out SIZE bytes at PTR. */
+void
+heapprof_alloc (enum heapprof_kind kind, void *ptr, size_t size) {
+	void *stack[SITE_DEPTH];
+	enum intr_level old_level;
+	size_t idx;
+	struct site *s;
+
+	if (sites == NULL || ptr == NULL)
+		return;
+
+	capture_stack (stack);
+	old_level = intr_disable ();
+
+	idx = site_lookup (kind, stack);
+	s = &sites[idx];
+	s->alloc_cnt++;
+	s->alloc_bytes += size;
+
+	/* Keep one free entry so probing always terminates. */
+	if (live_cnt < LIVE_CNT - 1) {
+		live_insert (&(struct live) { .ptr = ptr, .size = size, .site = idx });
+		s->live_bytes += size;
+		s->live_cnt++;
+	} else
+		dropped_cnt++;
+
+	intr_set_level (old_level);
+}
+
+/* Records that the block at PTR was freed.  Blocks that were never
+   recorded are ignored. */
+void
+heapprof_free (void *ptr) {
+	enum intr_level old_level;
+	struct live entry;
+
+	if (sites == NULL || ptr == NULL)
+		return;
+
+	old_level = intr_disable ();
+	if (live_remove (ptr, &entry)) {
+		sites[entry.site].live_bytes -= entry.size;
+		sites[entry.site].live_cnt--;
+	}
+	intr_set_level (old_level);
+}
+
+/* Records that the block at FROM now lives at TO, still charged to
+   the site that allocated it. */
+void
+heapprof_move (void *from, void *to) {
+	enum intr_level old_level;
+	struct live entry;
+
+	if (sites == NULL)
+		return;
+
+	old_level = intr_disable ();
+	if (live_remove (from, &entry)) {
+		entry.ptr = to;
+		live_insert (&entry);
+	}
+	intr_set_level (old_level);
+}
+
+/* Returns the allocation rate of site S, in allocations per
+   second. */
+static uint64_t
+site_rate (const struct site *s) {
+	int64_t ticks = timer_elapsed (s->first_tick) + 1;
+	return s->alloc_cnt * TIMER_FREQ / ticks;
+}
+
+/* Prints the TOP_CNT sites with the highest KEY, most first, in a
+   form that the `backtrace' utility accepts. */
+static void
+print_top (const char *title, uint64_t (*key) (const struct site *)) {
+	static bool printed[SITE_CNT];
+	size_t rank, i;
+
+	memset (printed, 0, sizeof printed);
+	printf ("Top sites by %s:\n", title);
+	for (rank = 1; rank <= TOP_CNT; rank++) {
+		struct site *best = NULL;
+		size_t best_idx = 0;
+
+		for (i = 0; i < SITE_CNT; i++)
+			if (sites[i].in_use && sites[i].alloc_cnt > 0 && !printed[i]
+					&& (best == NULL || key (&sites[i]) > key (best))) {
+				best = &sites[i];
+				best_idx = i;
+			}
+		if (best == NULL)
+			break;
+		printed[best_idx] = true;
+
+		printf ("%2zu: %s, %zu bytes live in %zu blocks, "
+				"%llu allocations (%llu bytes), %llu/s\n",
+				rank, best->kind == HEAPPROF_MALLOC ? "malloc" : "palloc",
+				best->live_bytes, best->live_cnt, best->alloc_cnt,
+				best->alloc_bytes, site_rate (best));
+		if (best_idx == OVERFLOW_SITE)
+			printf ("    (sites not tracked individually)\n");
+		else {
+			printf ("    Call stack:");
+			for (i = 0; i < SITE_DEPTH && best->stack[i] != NULL; i++)
+				printf (" %p", best->stack[i]);
+			printf (".\n");
+		}
+	}
+}
+
+static uint64_t
+site_live_bytes (const struct site *s) {
+	return s->live_bytes;
+}
+
+/* Prints the heap profile: the top sites by live bytes and by
+   allocation rate. */
+void
+heapprof_print (void) {
+	if (sites == NULL)
+		return;
+
+	printf ("Heap profile: %zu live allocations tracked, %llu dropped\n",
+			live_cnt, dropped_cnt);
+	print_top ("live bytes", site_live_bytes);
+	print_top ("allocation rate", site_rate);
+	printf ("Use the `backtrace' utility to resolve the call stacks.\n");
+}
+
+#endif /* HEAPPROF */
@@ -13,6 +13,7 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/heapprof.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -31,6 +32,7 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -57,6 +59,10 @@ static void paging_init (uint64_t mem_end);
 static char **read_command_line (void);
 static char **parse_options (char **argv);
 static void run_actions (char **argv);
+static void run_memstat (char **argv);
+#ifdef HEAPPROF
+static void run_heapprof (char **argv);
+#endif
 static void usage (void);
 
 static void print_stats (void);
@@ -86,6 +92,9 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+#ifdef HEAPPROF
+	heapprof_init ();
+#endif
 	paging_init (mem_end);
 
 #ifdef USERPROG
@@ -151,7 +160,8 @@ static void
 paging_init (uint64_t mem_end) {
 	uint64_t *pml4, *pte;
 	int perm;
-	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+	pml4 = base_pml4 = palloc_get_page (PAL_ASSERT | PAL_ZERO
+			| PAL_TAG (MEM_PAGETABLE));
 
 	extern char start, _end_kernel_text;
 	// Maps physical address [0 ~ mem_end] to
@@ -169,6 +179,8 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+	pml4_pcid_init ();
+	pml4_pt_init (mem_end);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -253,6 +265,20 @@ parse_options (char **argv) {
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;  // 스레드 테스트 모드를 활성화.
 #endif
+#ifdef VM
+		else if (!strcmp (name, "-zswap"))
+			zswap_page_limit = atoi (value);
+		else if (!strcmp (name, "-fa"))
+			fault_around_pages = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			merge_pages_per_pass = atoi (value);
+		else if (!strcmp (name, "-ksm-sleep"))
+			merge_interval = atoi (value);
+		else if (!strcmp (name, "-no-pff"))
+			pff_enabled = false;
+		else if (!strcmp (name, "-no-thp"))
+			thp_enabled = false;
+#endif
 
 		// 알 수 없는 옵션이 있을 경우, 시스템을 패닉 상태로 만들고 종료.
 		else
@@ -320,6 +346,10 @@ run_actions (char **argv) {
 	   */
 	static const struct action actions[] = {
 		{"run", 2, run_task},    // "run" 명령어, 인자 2개 필요, 실행할 함수는 run_task
+		{"memstat", 1, run_memstat},
+#ifdef HEAPPROF
+		{"heapprof", 1, run_heapprof},
+#endif
 #ifdef FILESYS
 		{"ls", 1, fsutil_ls},    // "ls" 명령어, 인자 1개 필요, 실행할 함수는 fsutil_ls
 		{"cat", 2, fsutil_cat},  // "cat" 명령어, 인자 2개 필요, 실행할 함수는 fsutil_cat
@@ -359,6 +389,46 @@ run_actions (char **argv) {
 	}
 }
 
+/* Prints kernel memory usage: both page allocator pools, the
+   pages allocated for each subsystem, and the occupancy of each
+   malloc() size class. */
+static void
+run_memstat (char **argv UNUSED) {
+	static const char *tag_names[MEM_TAG_CNT] = {
+		"other", "thread", "pagetable", "malloc", "vm", "filesys",
+	};
+	static struct memstat st;
+	size_t i;
+
+	palloc_get_stats (&st);
+	malloc_get_stats (&st);
+
+	printf ("Memory: kernel pool %llu/%llu pages used (peak %llu, %llu failed)\n",
+			st.kernel_pool.used_pages, st.kernel_pool.total_pages,
+			st.kernel_pool.peak_pages, st.kernel_pool.failed_cnt);
+	printf ("Memory: user pool %llu/%llu pages used (peak %llu, %llu failed)\n",
+			st.user_pool.used_pages, st.user_pool.total_pages,
+			st.user_pool.peak_pages, st.user_pool.failed_cnt);
+	for (i = 0; i < MEM_TAG_CNT; i++)
+		printf ("Memory: %-9s %6llu pages\n", tag_names[i], st.tag_pages[i]);
+	for (i = 0; i < st.desc_cnt; i++) {
+		struct memstat_desc *d = &st.descs[i];
+		printf ("Memory: malloc %4llu B: %llu arenas, %llu used, %llu free\n",
+				d->block_size, d->arena_cnt, d->used_blocks, d->free_blocks);
+	}
+	printf ("Memory: malloc big blocks: %llu using %llu pages\n",
+			st.big_block_cnt, st.big_block_pages);
+}
+
+#ifdef HEAPPROF
+/* Prints the kernel allocation sites with the most live memory
+   and the highest allocation rates. */
+static void
+run_heapprof (char **argv UNUSED) {
+	heapprof_print ();
+}
+#endif
+
 /* Prints a kernel command line help message and powers off the
    machine. */
 static void
@@ -371,6 +441,10 @@ usage (void) {
 			"  run 'PROG [ARG...]' Run PROG and wait for it to complete.\n"
 #else
 			"  run TEST           Run TEST.\n"
+#endif
+			"  memstat            Print kernel memory usage.\n"
+#ifdef HEAPPROF
+			"  heapprof           Print the top kernel allocation sites.\n"
 #endif
 #ifdef FILESYS
 			"  ls                 List files in the root directory.\n"
@@ -388,6 +462,14 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -zswap=COUNT       Limit compressed swap cache to COUNT pages.\n"
+			"  -fa=COUNT          Map up to COUNT pages around file faults.\n"
+			"  -ksm=COUNT         Scan COUNT frames per pass for merging (0=off).\n"
+			"  -ksm-sleep=TICKS   Sleep TICKS timer ticks between merge passes.\n"
+			"  -no-pff            Do not give processes frame quotas.\n"
+			"  -no-thp            Do not map anonymous memory with huge pages.\n"
 #endif
 			);
 	power_off ();
@@ -419,7 +501,14 @@ print_stats (void) {
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
+	pml4_print_stats ();
+#ifdef HEAPPROF
+	heapprof_print ();
+#endif
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+#endif
 }
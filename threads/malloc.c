@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/heapprof.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -40,6 +41,8 @@ struct desc {
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+	size_t arena_cnt;           /* Number of arenas. */
+	size_t used_cnt;            /* Number of blocks handed out. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -61,6 +64,11 @@ struct block {
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Blocks bigger than 2 kB. */
+static struct lock big_lock;    /* Protects the counters below. */
+static size_t big_cnt;          /* Number of big blocks. */
+static size_t big_pages;        /* Pages they occupy. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -77,6 +85,7 @@ malloc_init (void) {
 		list_init (&d->free_list);
 		lock_init (&d->lock);
 	}
+	lock_init (&big_lock);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -100,15 +109,21 @@ malloc (size_t size) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
 		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
+		a = palloc_get_multiple (PAL_TAG (MEM_MALLOC), page_cnt);
 		if (a == NULL)
 			return NULL;
 
+		lock_acquire (&big_lock);
+		big_cnt++;
+		big_pages += page_cnt;
+		lock_release (&big_lock);
+
 		/* Initialize the arena to indicate a big block of PAGE_CNT
 		   pages, and return it. */
 		a->magic = ARENA_MAGIC;
 		a->desc = NULL;
 		a->free_cnt = page_cnt;
+		HEAPPROF_ALLOC (HEAPPROF_MALLOC, a + 1, size);
 		return a + 1;
 	}
 
@@ -119,11 +134,12 @@ malloc (size_t size) {
 		size_t i;
 
 		/* Allocate a page. */
-		a = palloc_get_page (0);
+		a = palloc_get_page (PAL_TAG (MEM_MALLOC));
 		if (a == NULL) {
 			lock_release (&d->lock);
 			return NULL;
 		}
+		d->arena_cnt++;
 
 		/* Initialize arena and add its blocks to the free list. */
 		a->magic = ARENA_MAGIC;
@@ -139,7 +155,9 @@ malloc (size_t size) {
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
 	a->free_cnt--;
+	d->used_cnt++;
 	lock_release (&d->lock);
+	HEAPPROF_ALLOC (HEAPPROF_MALLOC, b, size);
 	return b;
 }
 
@@ -205,6 +223,7 @@ free (void *p) {
 		struct arena *a = block_to_arena (b);
 		struct desc *d = a->desc;
 
+		HEAPPROF_FREE (p);
 		if (d != NULL) {
 			/* It's a normal block.  We handle it here. */
 
@@ -217,6 +236,7 @@ free (void *p) {
 
 			/* Add block to free list. */
 			list_push_front (&d->free_list, &b->free_elem);
+			d->used_cnt--;
 
 			/* If the arena is now entirely unused, free it. */
 			if (++a->free_cnt >= d->blocks_per_arena) {
@@ -228,17 +248,48 @@ free (void *p) {
 					list_remove (&b->free_elem);
 				}
 				palloc_free_page (a);
+				d->arena_cnt--;
 			}
 
 			lock_release (&d->lock);
 		} else {
 			/* It's a big block.  Free its pages. */
+			lock_acquire (&big_lock);
+			big_cnt--;
+			big_pages -= a->free_cnt;
+			lock_release (&big_lock);
+
 			palloc_free_multiple (a, a->free_cnt);
 			return;
 		}
 	}
 }
 
+/* Fills in the malloc() part of ST: the occupancy of each
+   descriptor's arenas and the big blocks. */
+void
+malloc_get_stats (struct memstat *st) {
+	size_t i;
+
+	st->desc_cnt = desc_cnt < MEMSTAT_DESC_CNT ? desc_cnt : MEMSTAT_DESC_CNT;
+	for (i = 0; i < st->desc_cnt; i++) {
+		struct desc *d = &descs[i];
+		struct memstat_desc *sd = &st->descs[i];
+
+		lock_acquire (&d->lock);
+		sd->block_size = d->block_size;
+		sd->arena_cnt = d->arena_cnt;
+		sd->used_blocks = d->used_cnt;
+		sd->free_blocks = d->arena_cnt * d->blocks_per_arena - d->used_cnt;
+		lock_release (&d->lock);
+	}
+
+	lock_acquire (&big_lock);
+	st->big_block_cnt = big_cnt;
+	st->big_block_pages = big_pages;
+	lock_release (&big_lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
@@ -1,57 +1,187 @@
+#include <round.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+static void tlb_flush_page (uint64_t *pml4, const void *va);
+
+/* Page table reclamation.
+
+   The page tables, page directories and page directory pointer
+   tables of a user address space are freed as soon as none of their
+   entries is present, rather than only by pml4_destroy(), so that a
+   process that maps and unmaps memory over and over does not pile
+   up empty tables.  Each table page's population, the number of its
+   present entries, is kept in PT_POP, indexed by physical page
+   number.  The number of table pages a pml4 uses, not counting
+   itself, is kept in its PT_CNT_SLOT slot, with the present bit
+   clear so the hardware ignores it, as with the PCID.
+
+   Tables are numbered by level: 1 for a page table, up to 3 for a
+   page directory pointer table.  Only tables under a top-level slot
+   that base_pml4 does not use are counted, since the others are
+   shared with the kernel. */
+#define PT_CNT_SLOT 510                 /* PML4 slot holding the count. */
+
+static uint16_t *pt_pop;                /* Present entries per table. */
+static long long pt_alloc_cnt;          /* # of tables allocated. */
+static long long pt_free_cnt;           /* # of tables freed when empty. */
+
+/* Sets up population counts for the tables in the MEM_END bytes of
+   physical memory.  Must be called after base_pml4 is built. */
+void
+pml4_pt_init (uint64_t mem_end) {
+	size_t bytes = (mem_end >> PGBITS) * sizeof *pt_pop;
+
+	pt_pop = palloc_get_multiple (PAL_ASSERT | PAL_TAG (MEM_PAGETABLE),
+			DIV_ROUND_UP (bytes, PGSIZE));
+}
+
+/* Returns true if the tables on the path to VA in PML4 are counted. */
+static bool
+pt_counted (uint64_t *pml4, uint64_t va) {
+	return pml4 != base_pml4 && !(base_pml4[PML4 (va)] & PTE_P);
+}
+
+/* Returns the population count of TABLE. */
+static uint16_t *
+pt_pop_of (uint64_t *table) {
+	return &pt_pop[vtop (table) >> PGBITS];
+}
+
+/* Adds DELTA to the number of tables that PML4 uses. */
+static void
+pt_cnt_add (uint64_t *pml4, long delta) {
+	pml4[PT_CNT_SLOT] = (uint64_t) ((long) (pml4[PT_CNT_SLOT] >> 1) + delta) << 1;
+}
+
+/* Returns the number of pages that PML4 and its counted tables take. */
+size_t
+pml4_table_pages (uint64_t *pml4) {
+	return pml4 != NULL ? 1 + (pml4[PT_CNT_SLOT] >> 1) : 0;
+}
+
+/* Returns the entry that points to the level-LEVEL table on the path
+   to VA in PML4.  All the tables above it must exist. */
 static uint64_t *
-pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
+pt_entry (uint64_t *pml4, uint64_t va, int level) {
+	uint64_t *e = &pml4[PML4 (va)];
+
+	for (int l = 3; l > level; l--)
+		e = (uint64_t *) ptov (PTE_ADDR (*e))
+			+ ((va >> (PTXSHIFT + 9 * (l - 1))) & 0x1FF);
+	return e;
+}
+
+/* Allocates an empty level-LEVEL table on the path to VA in PML4, and
+   points ENTRY, which must not be present, at it.  Returns the table,
+   or a null pointer if memory allocation fails. */
+static uint64_t *
+pt_alloc (uint64_t *pml4, uint64_t *entry, uint64_t va, int level) {
+	uint64_t *table = palloc_get_page (PAL_ZERO | PAL_TAG (MEM_PAGETABLE));
+
+	if (table == NULL)
+		return NULL;
+	*entry = vtop (table) | PTE_U | PTE_W | PTE_P;
+	if (pt_counted (pml4, va)) {
+		*pt_pop_of (table) = 0;
+		if (level < 3)
+			++*pt_pop_of (pg_round_down (entry));
+		pt_cnt_add (pml4, 1);
+		pt_alloc_cnt++;
+	}
+	return table;
+}
+
+/* Frees the level-LEVEL table on the path to VA in PML4 that ENTRY
+   points to, which must have no present entries, and clears ENTRY.
+   Returns true if this leaves the table that holds ENTRY empty. */
+static bool
+pt_free (uint64_t *pml4, uint64_t *entry, uint64_t va, int level) {
+	void *table = ptov (PTE_ADDR (*entry));
+	bool empty = false;
+
+	*entry = 0;
+	tlb_flush_page (pml4, (void *) va);
+	palloc_free_page (table);
+	if (pt_counted (pml4, va)) {
+		if (level < 3)
+			empty = --*pt_pop_of (pg_round_down (entry)) == 0;
+		pt_cnt_add (pml4, -1);
+		pt_free_cnt++;
+	}
+	return empty;
+}
+
+/* Accounts for an entry of TABLE, on the path to VA in PML4, that
+   became present. */
+static void
+pt_get (uint64_t *pml4, uint64_t *table, uint64_t va) {
+	if (pt_counted (pml4, va))
+		++*pt_pop_of (table);
+}
+
+/* Accounts for CNT entries of TABLE, on the path to VA in PML4, that
+   are no longer present.  Returns true if TABLE is left empty, in
+   which case the caller should pass it to pt_prune(). */
+static bool
+pt_put (uint64_t *pml4, uint64_t *table, uint64_t va, size_t cnt) {
+	if (!pt_counted (pml4, va))
+		return false;
+	ASSERT (*pt_pop_of (table) >= cnt);
+	return (*pt_pop_of (table) -= cnt) == 0;
+}
+
+/* Frees the level-LEVEL table on the path to VA in PML4, which has
+   no present entries, and the tables above it that this leaves
+   empty. */
+static void
+pt_prune (uint64_t *pml4, uint64_t va, int level) {
+	while (level <= 3 && pt_free (pml4, pt_entry (pml4, va, level), va, level))
+		level++;
+}
+
+static uint64_t *
+pgdir_walk (uint64_t *pml4, uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
-			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page)
-					pdp[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-				else
-					return NULL;
-			} else
+			if (!create || pt_alloc (pml4, &pdp[idx], va, 1) == NULL)
 				return NULL;
 		}
+		/* A 2 MB page has no page table entries. */
+		if (pdp[idx] & PTE_PS)
+			return NULL;
 		return (uint64_t *) ptov (PTE_ADDR (pdp[idx]) + 8 * PTX (va));
 	}
 	return NULL;
 }
 
 static uint64_t *
-pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
+pdpe_walk (uint64_t *pml4, uint64_t *pdpe, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
 	int idx = PDPE (va);
 	int allocated = 0;
 	if (pdpe) {
 		uint64_t *pde = (uint64_t *) pdpe[idx];
 		if (!((uint64_t) pde & PTE_P)) {
-			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page) {
-					pdpe[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-					allocated = 1;
-				} else
-					return NULL;
-			} else
+			if (!create || pt_alloc (pml4, &pdpe[idx], va, 2) == NULL)
 				return NULL;
+			allocated = 1;
 		}
-		pte = pgdir_walk (ptov (PTE_ADDR (pdpe[idx])), va, create);
-	}
-	if (pte == NULL && allocated) {
-		palloc_free_page ((void *) ptov (PTE_ADDR (pdpe[idx])));
-		pdpe[idx] = 0;
+		pte = pgdir_walk (pml4, ptov (PTE_ADDR (pdpe[idx])), va, create);
 	}
+	if (pte == NULL && allocated)
+		pt_free (pml4, &pdpe[idx], va, 2);
 	return pte;
 }
 
@@ -69,32 +199,490 @@ pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	if (pml4e) {
 		uint64_t *pdpe = (uint64_t *) pml4e[idx];
 		if (!((uint64_t) pdpe & PTE_P)) {
-			if (create) {
-				uint64_t *new_page = palloc_get_page (PAL_ZERO);
-				if (new_page) {
-					pml4e[idx] = vtop (new_page) | PTE_U | PTE_W | PTE_P;
-					allocated = 1;
-				} else
-					return NULL;
-			} else
+			if (!create || pt_alloc (pml4e, &pml4e[idx], va, 3) == NULL)
 				return NULL;
+			allocated = 1;
 		}
-		pte = pdpe_walk (ptov (PTE_ADDR (pml4e[idx])), va, create);
-	}
-	if (pte == NULL && allocated) {
-		palloc_free_page ((void *) ptov (PTE_ADDR (pml4e[idx])));
-		pml4e[idx] = 0;
+		pte = pdpe_walk (pml4e, ptov (PTE_ADDR (pml4e[idx])), va, create);
 	}
+	if (pte == NULL && allocated)
+		pt_free (pml4e, &pml4e[idx], va, 3);
 	return pte;
 }
 
+/* Process-context identifiers (PCIDs).
+
+   Without PCIDs, every CR3 load flushes the whole TLB, so each
+   switch between two processes starts with a cold TLB.  When the
+   CPU supports them, we tag each user pml4 with a 12-bit PCID and
+   reload CR3 with the no-flush bit set, so the translations of a
+   process survive while other processes run.
+
+   PCID 0 belongs to base_pml4.  A user pml4 receives a PCID on its
+   first activation.  The PCID is kept in a top-level slot that no
+   mapping uses (PCID_SLOT), with the present bit clear so the
+   hardware ignores it.  When all PCIDs are taken, one is recycled
+   from another pml4 in round-robin order; that pml4 just gets a
+   new PCID the next time it is activated.
+
+   The TLB may still hold entries tagged with a PCID on behalf of
+   its previous owner, or stale entries of a pml4 that we modified
+   while it was not active.  Such a PCID is marked stale, and its
+   next activation loads CR3 without the no-flush bit, which drops
+   the entries of that PCID only. */
+#define PCID_CNT 4096                   /* Number of PCIDs. */
+#define PCID_SLOT 511                   /* PML4 slot holding the PCID. */
+#define CR3_PCID_MASK 0xfffUL           /* PCID bits of CR3. */
+#define CR3_NOFLUSH (1UL << 63)         /* Keep TLB entries of the PCID. */
+#define CR4_PCIDE (1UL << 17)           /* Enables PCIDs. */
+#define CPUID_PCID (1U << 17)           /* CPUID.01H:ECX, PCIDs supported. */
+
+#define pml4_pcid(pml4) ((unsigned) ((pml4)[PCID_SLOT] >> 1))
+
+static bool pcid_enabled;               /* CR4.PCIDE is set. */
+static uint64_t *pcid_owner[PCID_CNT];  /* Pml4 using each PCID. */
+static bool pcid_stale[PCID_CNT];       /* Flush on next activation. */
+static unsigned pcid_hand = 1;          /* Next PCID to hand out. */
+static unsigned pcid_used;              /* Number of PCIDs owned. */
+static long long pcid_recycle_cnt;      /* # of PCIDs taken away. */
+
+/* Enables PCIDs if the CPU supports them.  Must be called while
+   base_pml4 is active, since CR4.PCIDE can only be set when the
+   PCID bits of CR3 are zero. */
+void
+pml4_pcid_init (void) {
+	ASSERT ((rcr3 () & CR3_PCID_MASK) == 0);
+
+	if (cpuid_ecx (1) & CPUID_PCID) {
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+	}
+}
+
+/* Gives PML4 a PCID, taking one away from another pml4 if none is
+   free, and returns it.  Interrupts must be off. */
+static unsigned
+pcid_assign (uint64_t *pml4) {
+	unsigned active = rcr3 () & CR3_PCID_MASK;
+	unsigned pcid;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (;;) {
+		pcid = pcid_hand;
+		pcid_hand = pcid_hand % (PCID_CNT - 1) + 1;
+		if (pcid_owner[pcid] == NULL)
+			break;
+		if (pcid_used == PCID_CNT - 1 && pcid != active) {
+			/* Out of PCIDs: recycle this one. */
+			pcid_owner[pcid][PCID_SLOT] = 0;
+			pcid_used--;
+			pcid_recycle_cnt++;
+			break;
+		}
+	}
+
+	pcid_owner[pcid] = pml4;
+	pcid_used++;
+	pcid_stale[pcid] = true;
+	pml4[PCID_SLOT] = (uint64_t) pcid << 1;
+	return pcid;
+}
+
+/* Releases the PCID of PML4, if it has one. */
+static void
+pcid_release (uint64_t *pml4) {
+	enum intr_level old_level = intr_disable ();
+	unsigned pcid = pml4_pcid (pml4);
+
+	if (pcid != 0) {
+		ASSERT (pcid_owner[pcid] == pml4);
+		pcid_owner[pcid] = NULL;
+		pcid_used--;
+		pml4[PCID_SLOT] = 0;
+	}
+	intr_set_level (old_level);
+}
+
+/* Invalidates the TLB entry for user virtual page VA in PML4.  If
+   PML4 is not the active one, its PCID is flushed as a whole on its
+   next activation instead; without PCIDs, that activation flushes
+   the TLB anyway. */
+static void
+tlb_flush_page (uint64_t *pml4, const void *va) {
+	if (PTE_ADDR (rcr3 ()) == vtop (pml4))
+		invlpg ((uint64_t) va);
+	else if (pcid_enabled && pml4_pcid (pml4) != 0)
+		pcid_stale[pml4_pcid (pml4)] = true;
+}
+
+/* Prints PCID statistics. */
+void
+pml4_print_stats (void) {
+	if (pcid_enabled)
+		printf ("PCID: %u in use, %lld recycled\n", pcid_used, pcid_recycle_cnt);
+	printf ("Page tables: %lld allocated, %lld freed when emptied\n",
+			pt_alloc_cnt, pt_free_cnt);
+}
+
+/* Range operations.
+
+   pml4_set_page() and friends walk the four levels from the root
+   for every page.  The range functions below walk down to a page
+   table once and then handle all of its entries that fall into the
+   range, skipping subtrees that are not present.  TLB invalidation
+   is batched: a few pages are invalidated one by one, larger ranges
+   flush the address space at once. */
+#define TLB_FLUSH_MAX 32        /* Max pages invalidated one by one. */
+
+/* Returns the first address past VA aligned to 2**SHIFT. */
+#define next_boundary(va, shift) (((va) | ((1UL << (shift)) - 1)) + 1)
+
+/* Virtual pages whose TLB entries must be invalidated. */
+struct tlb_batch {
+	uint64_t lo, hi;            /* Lowest and highest page. */
+	size_t cnt;                 /* Number of pages. */
+};
+
+static void
+tlb_batch_add (struct tlb_batch *b, uint64_t va) {
+	if (b->cnt++ == 0)
+		b->lo = va;
+	b->hi = va;
+}
+
+/* Invalidates the pages collected in B for PML4. */
+static void
+tlb_batch_flush (uint64_t *pml4, struct tlb_batch *b) {
+	if (b->cnt == 0)
+		return;
+	if (PTE_ADDR (rcr3 ()) != vtop (pml4))
+		tlb_flush_page (pml4, (void *) b->lo);
+	else if ((b->hi - b->lo) / PGSIZE < TLB_FLUSH_MAX) {
+		for (uint64_t va = b->lo; va <= b->hi; va += PGSIZE)
+			invlpg (va);
+	} else {
+		/* Reloading CR3 without the no-flush bit drops the entries
+		   of the active PCID, or the whole TLB without PCIDs. */
+		lcr3 (rcr3 ());
+	}
+	b->cnt = 0;
+}
+
+/* Returns the page table that maps VA in PML4, or a null pointer if
+   there is none.  In the latter case, *NEXT is set to the first
+   address past VA that might have a page table. */
+static uint64_t *
+pt_find (uint64_t *pml4, uint64_t va, uint64_t *next) {
+	uint64_t e = pml4[PML4 (va)];
+	if (!(e & PTE_P)) {
+		*next = next_boundary (va, PML4SHIFT);
+		return NULL;
+	}
+	e = ((uint64_t *) ptov (PTE_ADDR (e)))[PDPE (va)];
+	if (!(e & PTE_P)) {
+		*next = next_boundary (va, PDPESHIFT);
+		return NULL;
+	}
+	e = ((uint64_t *) ptov (PTE_ADDR (e)))[PDX (va)];
+	if (!(e & PTE_P) || (e & PTE_PS)) {
+		*next = next_boundary (va, PDXSHIFT);
+		return NULL;
+	}
+	return ptov (PTE_ADDR (e));
+}
+
+/* Calls FUNC for each present PTE in PML4 that maps one of the
+   PAGE_CNT pages starting at UPAGE, in ascending order.  Stops and
+   returns false as soon as FUNC returns false. */
+bool
+pml4_for_each_range (uint64_t *pml4, void *upage, size_t page_cnt,
+		pte_for_each_func *func, void *aux) {
+	uint64_t va = (uint64_t) upage;
+	uint64_t end = va + page_cnt * PGSIZE;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (end - 1));
+
+	while (va < end) {
+		uint64_t next;
+		uint64_t *pt = pt_find (pml4, va, &next);
+		if (pt == NULL) {
+			va = next;
+			continue;
+		}
+
+		next = next_boundary (va, PDXSHIFT);
+		for (; va < end && va < next; va += PGSIZE) {
+			uint64_t *pte = &pt[PTX (va)];
+			if ((*pte & PTE_P) && !func (pte, (void *) va, aux))
+				return false;
+		}
+	}
+	return true;
+}
+
+/* Maps the PAGE_CNT user virtual pages starting at UPAGE to the
+   frames identified by kernel virtual addresses KPAGES[], like
+   pml4_set_page() does for a single page.  None of the pages may be
+   mapped yet.  Returns true if successful.  Returns false, leaving
+   the range unmapped, if memory allocation failed or one of the
+   pages is already mapped. */
+bool
+pml4_map_range (uint64_t *pml4, void *upage, void *const kpages[],
+		size_t page_cnt, bool rw) {
+	uint64_t va = (uint64_t) upage;
+	uint64_t end = va + page_cnt * PGSIZE;
+	size_t i = 0;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (end - 1));
+	ASSERT (pml4 != base_pml4);
+
+	while (va < end) {
+		uint64_t *pte = pml4e_walk (pml4, va, 1);
+		uint64_t next = next_boundary (va, PDXSHIFT);
+		uint64_t *pt;
+
+		if (pte == NULL)
+			goto fail;
+		pt = pg_round_down (pte);
+		for (; va < end && va < next; va += PGSIZE, i++) {
+			ASSERT (pg_ofs (kpages[i]) == 0);
+			if (pt[PTX (va)] & PTE_P)
+				goto fail;
+			pt[PTX (va)] = vtop (kpages[i]) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+			pt_get (pml4, pt, va);
+		}
+	}
+	return true;
+
+fail:
+	/* Only entries that were not present have been written, so there
+	   is nothing to invalidate, except for tables that empty out. */
+	for (size_t j = 0; j < i; j++) {
+		va = (uint64_t) upage + j * PGSIZE;
+		uint64_t *pte = pml4e_walk (pml4, va, 0);
+		*pte = 0;
+		if (pt_put (pml4, pg_round_down (pte), va, 1))
+			pt_prune (pml4, va, 1);
+	}
+	return false;
+}
+
+/* Marks the PAGE_CNT user virtual pages starting at UPAGE "not
+   present" in PML4, like pml4_clear_page() does for a single page,
+   and frees the tables that this empties.  The pages need not be
+   mapped. */
+void
+pml4_unmap_range (uint64_t *pml4, void *upage, size_t page_cnt) {
+	struct tlb_batch batch = { .cnt = 0 };
+	uint64_t va = (uint64_t) upage;
+	uint64_t end = va + page_cnt * PGSIZE;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (end - 1));
+
+	while (va < end) {
+		uint64_t next, first = va;
+		uint64_t *pt = pt_find (pml4, va, &next);
+		size_t cleared = 0;
+		if (pt == NULL) {
+			va = next;
+			continue;
+		}
+
+		next = next_boundary (va, PDXSHIFT);
+		for (; va < end && va < next; va += PGSIZE) {
+			uint64_t *pte = &pt[PTX (va)];
+			if (*pte & PTE_P) {
+				*pte &= ~PTE_P;
+				tlb_batch_add (&batch, va);
+				cleared++;
+			}
+		}
+		/* The table must not go while the TLB may still hold its
+		   entries. */
+		if (pt_put (pml4, pt, first, cleared)) {
+			tlb_batch_flush (pml4, &batch);
+			pt_prune (pml4, first, 1);
+		}
+	}
+	tlb_batch_flush (pml4, &batch);
+}
+
+/* Makes the mapped pages among the PAGE_CNT user virtual pages
+   starting at UPAGE read/write if RW is true, read-only otherwise. */
+void
+pml4_protect_range (uint64_t *pml4, void *upage, size_t page_cnt, bool rw) {
+	struct tlb_batch batch = { .cnt = 0 };
+	uint64_t va = (uint64_t) upage;
+	uint64_t end = va + page_cnt * PGSIZE;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (end - 1));
+
+	while (va < end) {
+		uint64_t next;
+		uint64_t *pt = pt_find (pml4, va, &next);
+		if (pt == NULL) {
+			va = next;
+			continue;
+		}
+
+		next = next_boundary (va, PDXSHIFT);
+		for (; va < end && va < next; va += PGSIZE) {
+			uint64_t *pte = &pt[PTX (va)];
+			if (!(*pte & PTE_P) || !!(*pte & PTE_W) == rw)
+				continue;
+			if (rw)
+				*pte |= PTE_W;
+			else
+				*pte &= ~(uint64_t) PTE_W;
+			tlb_batch_add (&batch, va);
+		}
+	}
+	tlb_batch_flush (pml4, &batch);
+}
+
+/* 2 MB pages.
+
+   A page directory entry with PTE_PS set maps a 2 MB page directly,
+   with no page table below it.  The walkers above treat such an
+   entry as having no page table entries, so the functions that work
+   on 4 kB pages leave it alone; pml4_get_page() and the dirty and
+   accessed bit functions see through it. */
+#define HPGSIZE (1UL << PDXSHIFT)      /* Bytes in a 2 MB page. */
+
+/* Returns the address of the page directory entry for VA in PML4.
+   If there is no page directory for VA, creates one if CREATE is
+   true, and otherwise returns a null pointer, as it does if memory
+   allocation fails. */
+static uint64_t *
+pde_walk (uint64_t *pml4, uint64_t va, bool create) {
+	uint64_t *table = pml4;
+
+	for (int level = 3; level > 1; level--) {
+		uint64_t *e = &table[(va >> (PTXSHIFT + 9 * level)) & 0x1FF];
+		if (!(*e & PTE_P)) {
+			if (!create || pt_alloc (pml4, e, va, level) == NULL) {
+				/* Do not leave an empty page directory pointer
+				   table behind. */
+				if (create && level == 2
+						&& pt_put (pml4, table, va, 0))
+					pt_prune (pml4, va, 3);
+				return NULL;
+			}
+		}
+		table = ptov (PTE_ADDR (*e));
+	}
+	return &table[PDX (va)];
+}
+
+/* Returns the entry that maps VA in PML4: its page table entry, or
+   the page directory entry of the 2 MB page that contains it.
+   Returns a null pointer if there is neither. */
+static uint64_t *
+leaf_walk (uint64_t *pml4, const void *va) {
+	uint64_t *pde = pde_walk (pml4, (uint64_t) va, false);
+
+	if (pde != NULL && (*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+		return pde;
+	return pml4e_walk (pml4, (uint64_t) va, false);
+}
+
+/* Maps the 2 MB of user virtual memory at UPAGE in PML4 to the 2 MB
+   of physically contiguous memory at kernel virtual address KPAGE,
+   with one page directory entry.  Both must be 2 MB aligned.  A page
+   table left over from earlier mappings is freed if none of its
+   entries is present.  Returns false if memory allocation fails or
+   part of the range is mapped. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	uint64_t *pde;
+
+	ASSERT ((uint64_t) upage % HPGSIZE == 0);
+	ASSERT (vtop (kpage) % HPGSIZE == 0);
+	ASSERT (is_user_vaddr ((uint8_t *) upage + HPGSIZE - 1));
+	ASSERT (pml4 != base_pml4);
+
+	pde = pde_walk (pml4, (uint64_t) upage, true);
+	if (pde == NULL)
+		return false;
+	if (*pde & PTE_P) {
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+
+		if (*pde & PTE_PS)
+			return false;
+		for (unsigned i = 0; i < PGSIZE / sizeof *pt; i++)
+			if (pt[i] & PTE_P)
+				return false;
+		/* The entry is made present again just below, so the page
+		   directory is not freed even if this empties it. */
+		pt_free (pml4, pde, (uint64_t) upage, 1);
+	}
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	pt_get (pml4, pg_round_down (pde), (uint64_t) upage);
+	return true;
+}
+
+/* Removes the 2 MB page mapped at UPAGE in PML4, if there is one. */
+void
+pml4_clear_huge_page (uint64_t *pml4, void *upage) {
+	uint64_t *pde = pde_walk (pml4, (uint64_t) upage, false);
+
+	ASSERT ((uint64_t) upage % HPGSIZE == 0);
+
+	if (pde != NULL && (*pde & PTE_PS)) {
+		*pde = 0;
+		tlb_flush_page (pml4, upage);
+		if (pt_put (pml4, pg_round_down (pde), (uint64_t) upage, 1))
+			pt_prune (pml4, (uint64_t) upage, 2);
+	}
+}
+
+/* Replaces the 2 MB page mapped at UPAGE in PML4 by a page table that
+   maps the same memory with 4 kB pages, each with the permissions and
+   the accessed and dirty bits of the 2 MB page.  Returns false,
+   leaving the mapping alone, if memory allocation fails. */
+bool
+pml4_split_huge_page (uint64_t *pml4, void *upage) {
+	uint64_t *pde = pde_walk (pml4, (uint64_t) upage, false);
+	uint64_t *pt = palloc_get_page (PAL_TAG (MEM_PAGETABLE));
+	enum intr_level old_level;
+	uint64_t pa, flags;
+
+	ASSERT ((uint64_t) upage % HPGSIZE == 0);
+	ASSERT (pde != NULL && (*pde & PTE_PS));
+
+	if (pt == NULL)
+		return false;
+
+	/* The owner could set the dirty bit while the entries are
+	   copied if it ran in between. */
+	old_level = intr_disable ();
+	pa = PTE_ADDR (*pde);
+	flags = *pde & (PTE_P | PTE_W | PTE_U | PTE_A | PTE_D);
+	for (unsigned i = 0; i < PGSIZE / sizeof *pt; i++)
+		pt[i] = (pa + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	tlb_flush_page (pml4, upage);
+	intr_set_level (old_level);
+	if (pt_counted (pml4, (uint64_t) upage)) {
+		*pt_pop_of (pt) = PGSIZE / sizeof *pt;
+		pt_cnt_add (pml4, 1);
+		pt_alloc_cnt++;
+	}
+	return true;
+}
+
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
  * allocation fails. */
 uint64_t *
 pml4_create (void) {
-	uint64_t *pml4 = palloc_get_page (0);
+	uint64_t *pml4 = palloc_get_page (PAL_TAG (MEM_PAGETABLE));
 	if (pml4)
 		memcpy (pml4, base_pml4, PGSIZE);
 	return pml4;
@@ -122,7 +710,7 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && !(pdp[i] & PTE_PS))
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -169,7 +757,7 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && !(pdp[i] & PTE_PS))
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -196,14 +784,37 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+	pcid_release (pml4);
 	palloc_free_page ((void *) pml4);
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD (and of every
+ * other pml4) are kept unless PD's PCID is stale. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned pcid = 0;
+		uint64_t cr3;
+
+		if (pml4 != base_pml4) {
+			pcid = pml4_pcid (pml4);
+			if (pcid == 0)
+				pcid = pcid_assign (pml4);
+		}
+		cr3 = vtop (pml4) | pcid;
+		if (pcid_stale[pcid])
+			pcid_stale[pcid] = false;
+		else
+			cr3 |= CR3_NOFLUSH;
+		lcr3 (cr3);
+		intr_set_level (old_level);
+	} else
+		lcr3 (vtop (pml4));
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -214,8 +825,10 @@ void *
 pml4_get_page (uint64_t *pml4, const void *uaddr) {
 	ASSERT (is_user_vaddr (uaddr));
 
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
+	uint64_t *pte = leaf_walk (pml4, uaddr);
 
+	if (pte && (*pte & PTE_PS))
+		return ptov (PTE_ADDR (*pte)) + (uint64_t) uaddr % HPGSIZE;
 	if (pte && (*pte & PTE_P))
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 	return NULL;
@@ -238,14 +851,41 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) upage, 1);
 
-	if (pte)
+	if (pte) {
+		uint64_t old = *pte;
 		*pte = vtop (kpage) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+		if (old & PTE_P)
+			tlb_flush_page (pml4, upage);
+		else
+			pt_get (pml4, pg_round_down (pte), (uint64_t) upage);
+	}
 	return pte != NULL;
 }
 
+/* Points the present mapping of user virtual page UPAGE in PML4 at
+ * the physical frame identified by kernel virtual address KPAGE,
+ * keeping its permissions and its accessed and dirty bits.
+ * Returns false if UPAGE is not mapped. */
+bool
+pml4_remap_page (uint64_t *pml4, void *upage, void *kpage) {
+	uint64_t *pte;
+
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (pg_ofs (kpage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (pte == NULL || (*pte & PTE_P) == 0)
+		return false;
+	*pte = vtop (kpage) | (*pte & PTE_FLAGS);
+	tlb_flush_page (pml4, upage);
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
- * bits in the page table entry are preserved.
+ * bits in the page table entry are preserved, unless that was the
+ * last present entry of its page table, which is then freed.
  * UPAGE need not be mapped. */
 void
 pml4_clear_page (uint64_t *pml4, void *upage) {
@@ -257,8 +897,9 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_flush_page (pml4, upage);
+		if (pt_put (pml4, pg_round_down (pte), (uint64_t) upage, 1))
+			pt_prune (pml4, (uint64_t) upage, 1);
 	}
 }
 
@@ -268,7 +909,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
  * Returns false if PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_dirty (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = leaf_walk (pml4, vpage);
 	return pte != NULL && (*pte & PTE_D) != 0;
 }
 
@@ -276,15 +917,14 @@ pml4_is_dirty (uint64_t *pml4, const void *vpage) {
  * in PML4. */
 void
 pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = leaf_walk (pml4, vpage);
 	if (pte) {
 		if (dirty)
 			*pte |= PTE_D;
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_flush_page (pml4, vpage);
 	}
 }
 
@@ -294,7 +934,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
  * PML4 contains no PTE for VPAGE. */
 bool
 pml4_is_accessed (uint64_t *pml4, const void *vpage) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = leaf_walk (pml4, vpage);
 	return pte != NULL && (*pte & PTE_A) != 0;
 }
 
@@ -302,14 +942,13 @@ pml4_is_accessed (uint64_t *pml4, const void *vpage) {
    VPAGE in PD. */
 void
 pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
-	uint64_t *pte = pml4e_walk (pml4, (uint64_t) vpage, false);
+	uint64_t *pte = leaf_walk (pml4, vpage);
 	if (pte) {
 		if (accessed)
 			*pte |= PTE_A;
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_flush_page (pml4, vpage);
 	}
 }
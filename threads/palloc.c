@@ -7,7 +7,10 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
+#include "threads/heapprof.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -26,11 +29,22 @@
    half to the user pool.  That should be huge overkill for the
    kernel pool, but that's just fine for demonstration purposes. */
 
-/* A memory pool. */
+/* A memory pool.
+
+   For memory accounting, each page of the pool has a tag byte
+   recording the enum mem_tag it was allocated with.  The counters
+   are updated with interrupts off, because pages are freed from the
+   scheduler, where the pool lock cannot be acquired. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+
+	uint8_t *tags;                  /* enum mem_tag of each page. */
+	size_t used_cnt;                /* Pages in use. */
+	size_t peak_cnt;                /* Maximum of used_cnt. */
+	size_t failed_cnt;              /* Failed allocations. */
+	size_t tag_cnt[MEM_TAG_CNT];    /* Allocated pages by tag. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -38,10 +52,21 @@ static struct pool kernel_pool, user_pool;
 
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
+/* Compaction of the user pool.  See palloc_compact(). */
+static palloc_migrate_func *migrate_func;
+static struct lock compact_lock;
+static uint64_t compact_cnt;            /* Compaction passes. */
+static uint64_t compact_scanned;        /* Pages that we tried to move. */
+static uint64_t compact_moved;          /* Pages moved. */
+static uint64_t compact_ticks;          /* Timer ticks spent compacting. */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void pool_account (struct pool *, size_t page_idx, size_t page_cnt,
+		enum mem_tag);
+static void pool_unaccount (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -232,6 +257,13 @@ split:
 			}
 		}
 	}
+
+	// Pages still marked used are the kernel image, the pool metadata
+	// and holes in the memory map.
+	kernel_pool.used_cnt = kernel_pool.peak_cnt = bitmap_count (
+			kernel_pool.used_map, 0, bitmap_size (kernel_pool.used_map), true);
+	user_pool.used_cnt = user_pool.peak_cnt = bitmap_count (
+			user_pool.used_map, 0, bitmap_size (user_pool.used_map), true);
 }
 
 /* Initializes the page allocator and get the memory size.
@@ -292,6 +324,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
     // 주어진 수의 연속된 페이지를 찾아서 할당. 실패 시 BITMAP_ERROR 반환
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
 	lock_release (&pool->lock);
+	pool_account (pool, page_idx, page_cnt, flags >> PAL_TAG_SHIFT);
 	void *pages;
 
     // 페이지가 정상적으로 할당된 경우
@@ -312,6 +345,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 		if (flags & PAL_ASSERT)
 			PANIC ("palloc_get: out of pages");
 	}
+	HEAPPROF_ALLOC (HEAPPROF_PALLOC, pages, PGSIZE * page_cnt);
 
 	return pages;  // 할당된 페이지들의 시작 주소 반환 또는 널 포인터 반환
 }
@@ -337,6 +371,48 @@ palloc_get_page (enum palloc_flags flags) {
 }
 
 
+/* Obtains and returns PAGE_CNT contiguous free pages, like
+   palloc_get_multiple(), whose first page is aligned to PAGE_CNT
+   pages.  PAGE_CNT must be a power of 2.
+
+   It never compacts the user pool, so it fails whenever the pool is
+   too fragmented for an aligned run, until the VM layer's
+   compaction daemon next runs, up to a second later.  Compacting
+   here would not help the VM layer, its only user pool caller: it
+   asks while holding the VM lock, and palloc_compact() cannot move
+   any frame then.  Callers must be able to do with smaller pages
+   in the meantime. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t pool_cnt = bitmap_size (pool->used_map);
+	size_t page_idx = BITMAP_ERROR, idx;
+	void *pages = NULL;
+
+	ASSERT (page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+
+	/* First index whose page is aligned. */
+	idx = (page_cnt - pg_no (pool->base) % page_cnt) % page_cnt;
+	lock_acquire (&pool->lock);
+	for (; idx + page_cnt <= pool_cnt; idx += page_cnt)
+		if (bitmap_none (pool->used_map, idx, page_cnt)) {
+			bitmap_set_multiple (pool->used_map, idx, page_cnt, true);
+			page_idx = idx;
+			break;
+		}
+	lock_release (&pool->lock);
+	pool_account (pool, page_idx, page_cnt, flags >> PAL_TAG_SHIFT);
+
+	if (page_idx != BITMAP_ERROR) {
+		pages = pool->base + PGSIZE * page_idx;
+		if (flags & PAL_ZERO)
+			memset (pages, 0, PGSIZE * page_cnt);
+	} else if (flags & PAL_ASSERT)
+		PANIC ("palloc_get: out of pages");
+	HEAPPROF_ALLOC (HEAPPROF_PALLOC, pages, PGSIZE * page_cnt);
+	return pages;
+}
+
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void
 palloc_free_multiple (void *pages, size_t page_cnt) {
@@ -355,11 +431,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 		NOT_REACHED ();
 
 	page_idx = pg_no (pages) - pg_no (pool->base);
+	HEAPPROF_FREE (pages);
 
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+	pool_unaccount (pool, page_idx, page_cnt);
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
 }
 
@@ -377,6 +455,7 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
      and subtract it from the pool's size. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
 	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t tag_pages = ROUND_UP (pgcnt, PGSIZE);
 
 	lock_init(&p->lock);
 	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
@@ -385,7 +464,11 @@ init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
 	// Mark all to unusable.
 	bitmap_set_all(p->used_map, true);
 
-	*bm_base += bm_pages;
+	// The tag array follows the bitmap.
+	p->tags = (uint8_t *) *bm_base + bm_pages;
+	memset (p->tags, MEM_OTHER, pgcnt);
+
+	*bm_base += bm_pages + tag_pages;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -397,3 +480,176 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Accounts for the PAGE_CNT pages starting at PAGE_IDX in POOL
+   being allocated with TAG.  PAGE_IDX is BITMAP_ERROR if the
+   allocation failed. */
+static void
+pool_account (struct pool *pool, size_t page_idx, size_t page_cnt,
+		enum mem_tag tag) {
+	enum intr_level old_level = intr_disable ();
+
+	if (page_idx != BITMAP_ERROR) {
+		ASSERT (tag < MEM_TAG_CNT);
+		memset (pool->tags + page_idx, tag, page_cnt);
+		pool->tag_cnt[tag] += page_cnt;
+		pool->used_cnt += page_cnt;
+		if (pool->used_cnt > pool->peak_cnt)
+			pool->peak_cnt = pool->used_cnt;
+	} else
+		pool->failed_cnt++;
+
+	intr_set_level (old_level);
+}
+
+/* Accounts for the PAGE_CNT pages starting at PAGE_IDX in POOL
+   being freed. */
+static void
+pool_unaccount (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	enum intr_level old_level = intr_disable ();
+
+	for (size_t i = page_idx; i < page_idx + page_cnt; i++)
+		pool->tag_cnt[pool->tags[i]]--;
+	pool->used_cnt -= page_cnt;
+
+	intr_set_level (old_level);
+}
+
+/* Copies the statistics of POOL into ST, and adds its pages by
+   tag to TAG_PAGES[]. */
+static void
+pool_get_stats (struct pool *pool, struct memstat_pool *st,
+		uint64_t tag_pages[]) {
+	enum intr_level old_level = intr_disable ();
+
+	st->total_pages = bitmap_size (pool->used_map);
+	st->used_pages = pool->used_cnt;
+	st->peak_pages = pool->peak_cnt;
+	st->failed_cnt = pool->failed_cnt;
+	for (int tag = 0; tag < MEM_TAG_CNT; tag++)
+		tag_pages[tag] += pool->tag_cnt[tag];
+
+	intr_set_level (old_level);
+}
+
+/* Returns the number of pages in the user pool and stores the
+   address of its first page in *BASE. */
+size_t
+palloc_user_pool (void **base) {
+	*base = user_pool.base;
+	return bitmap_size (user_pool.used_map);
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free (void) {
+	enum intr_level old_level = intr_disable ();
+	size_t free_cnt = bitmap_size (user_pool.used_map) - user_pool.used_cnt;
+
+	intr_set_level (old_level);
+	return free_cnt;
+}
+
+/* Sets the function that palloc_compact() uses to move a user
+   page.  MIGRATE copies the page at FROM to the free page at TO,
+   redirects every reference to FROM and returns true, or returns
+   false if the page at FROM cannot be moved. */
+void
+palloc_set_migrate (palloc_migrate_func *migrate) {
+	lock_init (&compact_lock);
+	migrate_func = migrate;
+}
+
+/* Moves pages in the user pool toward its end, until there is a
+   run of PAGE_CNT free pages at its start or the pages still in
+   the way cannot be moved.  Returns true if the user pool now has
+   a run of PAGE_CNT free pages.
+
+   Two scanners work toward each other: one goes up from the start
+   of the pool looking for pages to move, the other goes down from
+   the end looking for free pages to move them to. */
+bool
+palloc_compact (size_t page_cnt) {
+	struct pool *pool = &user_pool;
+	size_t lo = 0, hi = bitmap_size (pool->used_map);
+	size_t run_start = 0;
+	int64_t start;
+	bool success;
+
+	if (migrate_func == NULL)
+		return false;
+
+	lock_acquire (&compact_lock);
+	lock_acquire (&pool->lock);
+	success = bitmap_scan (pool->used_map, 0, page_cnt, false) != BITMAP_ERROR;
+	lock_release (&pool->lock);
+	if (success || hi - pool->used_cnt < page_cnt) {
+		lock_release (&compact_lock);
+		return success;
+	}
+
+	start = timer_ticks ();
+	compact_cnt++;
+	while (lo - run_start < page_cnt) {
+		size_t to;
+		bool moved;
+
+		/* Find the next used page and the last free page after it,
+		   and reserve the free page. */
+		lock_acquire (&pool->lock);
+		while (lo < hi && !bitmap_test (pool->used_map, lo))
+			lo++;
+		while (hi > lo && bitmap_test (pool->used_map, hi - 1))
+			hi--;
+		if (hi - lo < 2) {
+			lock_release (&pool->lock);
+			break;
+		}
+		to = hi - 1;
+		bitmap_mark (pool->used_map, to);
+		lock_release (&pool->lock);
+
+		compact_scanned++;
+		moved = migrate_func (pool->base + PGSIZE * lo,
+				pool->base + PGSIZE * to);
+
+		lock_acquire (&pool->lock);
+		if (moved) {
+			pool->tags[to] = pool->tags[lo];
+			bitmap_reset (pool->used_map, lo);
+			compact_moved++;
+			hi = to;
+			HEAPPROF_MOVE (pool->base + PGSIZE * lo, pool->base + PGSIZE * to);
+		} else {
+			bitmap_reset (pool->used_map, to);
+			run_start = lo + 1;
+		}
+		lock_release (&pool->lock);
+		lo++;
+	}
+
+	lock_acquire (&pool->lock);
+	success = bitmap_scan (pool->used_map, 0, page_cnt, false) != BITMAP_ERROR;
+	lock_release (&pool->lock);
+	compact_ticks += timer_elapsed (start);
+	lock_release (&compact_lock);
+	return success;
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	printf ("Compaction: %llu passes, %llu of %llu pages moved, "
+			"%llu ticks\n", compact_cnt, compact_moved, compact_scanned,
+			compact_ticks);
+}
+
+/* Fills in the page allocator part of ST: both pools and the pages
+   allocated under each tag. */
+void
+palloc_get_stats (struct memstat *st) {
+	for (int tag = 0; tag < MEM_TAG_CNT; tag++)
+		st->tag_pages[tag] = 0;
+	pool_get_stats (&kernel_pool, &st->kernel_pool, st->tag_pages);
+	pool_get_stats (&user_pool, &st->user_pool, st->tag_pages);
+}
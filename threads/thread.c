@@ -189,7 +189,7 @@ thread_create (const char *name, int priority,
 	ASSERT (function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page (PAL_ZERO);
+	t = palloc_get_page (PAL_ZERO | PAL_TAG (MEM_THREAD));
 	if (t == NULL)
 		return TID_ERROR;
 
@@ -198,6 +198,12 @@ thread_create (const char *name, int priority,
 	/* Initialize thread. */
 	init_thread (t, name, priority);
 	tid = t->tid = allocate_tid ();
+#ifdef USERPROG
+	if (!process_add_child (t)) {
+		palloc_free_page (t);
+		return TID_ERROR;
+	}
+#endif
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -407,6 +413,16 @@ thread_get_nice (void) {
 	return 0;
 }
 
+/* Returns the number of threads ready to run, not counting the
+   running thread. */
+size_t
+threads_ready (void) {
+	enum intr_level old_level = intr_disable ();
+	size_t cnt = list_size (&ready_list);
+	intr_set_level (old_level);
+	return cnt;
+}
+
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) {
@@ -488,6 +504,9 @@ init_thread (struct thread *t, const char *name, int priority) {
 	t->init_priority = priority;
 	t->wait_on_lock = NULL;
 	list_init(&t->donations);
+#ifdef USERPROG
+	list_init (&t->children);
+#endif
 }
 
 /* Chooses and returns the next thread to be scheduled.  Should
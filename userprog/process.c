@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <spawn.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +14,9 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "threads/vaddr.h"
@@ -26,6 +29,8 @@ static void process_cleanup (void);
 static bool load (const char *file_name, struct intr_frame *if_);
 static void initd (void *f_name);
 static void __do_fork (void *);
+static bool fd_table_copy (struct thread *parent);
+static void fd_table_free (struct thread *t);
 
 /* General process initializer for initd and other process. */
 static void
@@ -62,13 +67,6 @@ process_create_initd (const char *file_name) {
 	
 	// 추가 코드
 	strtok_r(file_name," ", &save_ptr);
-	printf("-----------file_name--------------\n");
-	printf("%s\n",file_name);
-	printf("-------------------------\n");
-
-	printf("------------fn_copy-------------\n");
-	printf("%s\n",fn_copy);
-	printf("-------------------------\n");
 	/* 파일 이름을 실행하는 새로운 스레드를 생성. */
 	tid = thread_create (file_name, PRI_DEFAULT, initd, fn_copy);  
 	if (tid == TID_ERROR)  // 스레드 생성 실패 시 페이지 해제
@@ -91,18 +89,38 @@ initd (void *f_name) {
 	NOT_REACHED ();
 }
 
-/* Clones the current process as `name`. Returns the new process's thread id, or
- * TID_ERROR if the thread cannot be created. */
+/* What process_fork() passes to the child it creates. */
+struct fork_info {
+	struct thread *parent;      /* Process that called fork(). */
+	struct intr_frame *if_;     /* Its user context at the fork() call. */
+	struct semaphore forked;    /* Upped once the child is set up. */
+	bool success;               /* Child set up successfully? */
+};
+
+/* Clones the current process as `name`.  IF_ is the user context at the
+ * system call, which the child resumes from with a return value of 0.
+ * Returns the new process's thread id once it is set up, or TID_ERROR
+ * if the thread cannot be created or copying the process fails. */
 tid_t
-process_fork (const char *name, struct intr_frame *if_ UNUSED) {
+process_fork (const char *name, struct intr_frame *if_) {
+	struct fork_info info = {
+		.parent = thread_current (),
+		.if_ = if_,
+	};
+	tid_t tid;
+
+	sema_init (&info.forked, 0);
 	/* Clone current thread to new thread.*/
-	return thread_create (name,
-			PRI_DEFAULT, __do_fork, thread_current ());
+	tid = thread_create (name, PRI_DEFAULT, __do_fork, &info);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+	sema_down (&info.forked);
+	return info.success ? tid : TID_ERROR;
 }
 
 #ifndef VM
 /* Duplicate the parent's address space by passing this function to the
- * pml4_for_each. This is only for the project 2. */
+ * pml4_for_each_range. This is only for the project 2. */
 static bool
 duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	struct thread *current = thread_current ();
@@ -111,42 +129,49 @@ duplicate_pte (uint64_t *pte, void *va, void *aux) {
 	void *newpage;
 	bool writable;
 
-	/* 1. TODO: If the parent_page is kernel page, then return immediately. */
+	/* 1. If the parent_page is kernel page, then return immediately. */
+	if (is_kernel_vaddr (va))
+		return true;
 
 	/* 2. Resolve VA from the parent's page map level 4. */
 	parent_page = pml4_get_page (parent->pml4, va);
+	if (parent_page == NULL)
+		return true;
 
-	/* 3. TODO: Allocate new PAL_USER page for the child and set result to
-	 *    TODO: NEWPAGE. */
+	/* 3. Allocate new PAL_USER page for the child. */
+	newpage = palloc_get_page (PAL_USER);
+	if (newpage == NULL)
+		return false;
 
-	/* 4. TODO: Duplicate parent's page to the new page and
-	 *    TODO: check whether parent's page is writable or not (set WRITABLE
-	 *    TODO: according to the result). */
+	/* 4. Duplicate parent's page to the new page, as writable as the
+	 *    parent's. */
+	memcpy (newpage, parent_page, PGSIZE);
+	writable = is_writable (pte);
 
 	/* 5. Add new page to child's page table at address VA with WRITABLE
 	 *    permission. */
 	if (!pml4_set_page (current->pml4, va, newpage, writable)) {
-		/* 6. TODO: if fail to insert page, do error handling. */
+		palloc_free_page (newpage);
+		return false;
 	}
 	return true;
 }
 #endif
 
-/* A thread function that copies parent's execution context.
- * Hint) parent->tf does not hold the userland context of the process.
- *       That is, you are required to pass second argument of process_fork to
- *       this function. */
+/* A thread function that copies parent's execution context, which
+ * process_fork() describes in AUX.  parent->tf does not hold the
+ * userland context of the process, so it comes from AUX too. */
 static void
 __do_fork (void *aux) {
+	struct fork_info *info = aux;
 	struct intr_frame if_;
-	struct thread *parent = (struct thread *) aux;
+	struct thread *parent = info->parent;
 	struct thread *current = thread_current ();
-	/* TODO: somehow pass the parent_if. (i.e. process_fork()'s if_) */
-	struct intr_frame *parent_if;
-	bool succ = true;
 
-	/* 1. Read the cpu context to local stack. */
-	memcpy (&if_, parent_if, sizeof (struct intr_frame));
+	/* 1. Read the cpu context to local stack.  fork() returns 0 in the
+	 *    child. */
+	memcpy (&if_, info->if_, sizeof (struct intr_frame));
+	if_.R.rax = 0;
 
 	/* 2. Duplicate PT */
 	current->pml4 = pml4_create();
@@ -156,75 +181,87 @@ __do_fork (void *aux) {
 	process_activate (current);
 #ifdef VM
 	supplemental_page_table_init (&current->spt);
+	/* The child's text pages read from its own copy of the
+	 * executable. */
+	if (parent->running_file != NULL) {
+		current->running_file = file_duplicate (parent->running_file);
+		if (current->running_file == NULL)
+			goto error;
+	}
 	if (!supplemental_page_table_copy (&current->spt, &parent->spt))
 		goto error;
+	current->heap_start = parent->heap_start;
+	current->heap_end = parent->heap_end;
 #else
-	if (!pml4_for_each (parent->pml4, duplicate_pte, parent))
+	if (!pml4_for_each_range (parent->pml4, NULL, pg_no (KERN_BASE),
+				duplicate_pte, parent))
 		goto error;
 #endif
 
-	/* TODO: Your code goes here.
-	 * TODO: Hint) To duplicate the file object, use `file_duplicate`
-	 * TODO:       in include/filesys/file.h. Note that parent should not return
-	 * TODO:       from the fork() until this function successfully duplicates
-	 * TODO:       the resources of parent.*/
+	if (!fd_table_copy (parent))
+		goto error;
 
 	process_init ();
 
-	/* Finally, switch to the newly created process. */
-	if (succ)
-		do_iret (&if_);
+	/* Finally, switch to the newly created process.  INFO lives on the
+	 * parent's stack, and is gone once the parent wakes up. */
+	info->success = true;
+	sema_up (&info->forked);
+	do_iret (&if_);
 error:
+	info->success = false;
+	sema_up (&info->forked);
+	current->exit_status = -1;
+	process_cleanup ();
 	thread_exit ();
 }
 
+/* Replaces the current process's image with the executable FILE_NAME,
+ * and sets up IF_ to start it with the ARGC arguments in ARGV on its
+ * stack.  Returns true if successful. */
+static bool
+process_load (const char *file_name, char **argv, int argc,
+		struct intr_frame *if_) {
+	/* We cannot use the intr_frame in the thread structure.
+	 * This is because when current thread rescheduled,
+	 * it stores the execution information to the member. */
+	memset (if_, 0, sizeof *if_);
+	if_->ds = if_->es = if_->ss = SEL_UDSEG;
+	if_->cs = SEL_UCSEG;
+	if_->eflags = FLAG_IF | FLAG_MBS;
+
+	/* We first kill the current context */
+	process_cleanup ();
+
+	if (!load (file_name, if_))
+		return false;
+	argument_stack (argv, argc, if_);
+	return true;
+}
+
 /* Switch the current execution context to the f_name.
  * Returns -1 on fail. */
 int process_exec (void *f_name) {
     char *file_name = f_name;
     bool success;
     // 명령어와 인자를 저장할 배열
-    char *token, *save_ptr, *argv[64]; // 명령어와 인자를 저장할 배열 (최대 64개 인자)
+    char *token, *save_ptr, *argv[SPAWN_ARG_MAX]; // 명령어와 인자를 저장할 배열 (최대 64개 인자)
     int argc = 0; // 인자의 개수
-
-    /* We cannot use the intr_frame in the thread structure.
-     * This is because when current thread rescheduled,
-     * it stores the execution information to the member. */
-		// 이 아래부분 초기화를 해주지 않으면
-		// 이전 프로세스를 실행할 때의 값들이 남아있을수 있기 때문에
-		// 여기서 새로 지역 변수로 설정해줘야 한다. 
     struct intr_frame _if;  
 		// 인터럽트 프레임: 프로그램 상태를 저장하기 위한 구조체
-    _if.ds = _if.es = _if.ss = SEL_UDSEG;  
-		// 데이터 세그먼트 설정 (유저모드 세그먼트 선택자)
-    _if.cs = SEL_UCSEG;  
-		// 코드 세그먼트 설정 (유저모드 세그먼트 선택자)
-    _if.eflags = FLAG_IF | FLAG_MBS;  
-		// 인터럽트 플래그 및 필수 플래그 설정
-
-    /* We first kill the current context */
-    process_cleanup();  
-		// 현재 프로세스의 자원 정리 (현재 실행 중인 프로그램 종료)
 
     // 명령어와 인자를 파싱하여 argv 배열에 저장
     token = strtok_r(file_name, " ", &save_ptr);  // 공백을 기준으로 첫 번째 명령어 추출
-    while (token != NULL) {
+    while (token != NULL && argc < SPAWN_ARG_MAX) {
         argv[argc] = token;  // 추출한 명령어 또는 인자를 argv 배열에 저장
         token = strtok_r(NULL, " ", &save_ptr);  // 다음 인자를 추출
         argc++;  // 인자 개수 증가
     }
 
     /* And then load the binary */
-    success = load(file_name, &_if);  
+    success = process_load(file_name, argv, argc, &_if);  
 		// 새로운 프로그램(사용자 프로그램)을 메모리에 로드하고 초기화
 
-		// Argument Passing ~
-    argument_stack(argv, argc, &_if); 
-		// 함수 내부에서 argv와 rsp의 값을 직접 변경하기 위해 주소 전달
-    
-		hex_dump(_if.rsp, _if.rsp, USER_STACK - (uint64_t)_if.rsp, true); // user stack을 16진수로 프린트
-    // ~ Argument Passing
-
     /* If load failed, quit. */
     palloc_free_page(file_name);  
 		// 파일 이름에 할당된 페이지를 해제
@@ -238,6 +275,121 @@ int process_exec (void *f_name) {
     NOT_REACHED();  // 정상적으로 실행될 경우 이 코드에 도달하지 않아야 함
 }
 
+/* What process_spawn() passes to the child it creates. */
+struct spawn_info {
+	struct thread *parent;      /* Process that called spawn(). */
+	const char *file;           /* Executable. */
+	char **argv;                /* Arguments, program name first. */
+	int argc;                   /* Elements in ARGV. */
+	const struct spawn_action *actions;     /* File descriptor actions. */
+	size_t action_cnt;          /* Elements in ACTIONS. */
+	struct semaphore loaded;    /* Upped once the child is set up. */
+	bool success;               /* Child set up successfully? */
+};
+
+static void __do_spawn (void *);
+
+/* Starts a new process running the executable FILE with the ARGC
+ * arguments in ARGV, whose first element is the program name.  Unlike
+ * process_fork() followed by process_exec(), it does not copy the
+ * current process's address space: the child starts empty and loads
+ * FILE.  The child's file descriptor table is a copy of the current
+ * process's, changed by the ACTION_CNT ACTIONS.  All the arguments are
+ * kernel memory, which must stay valid until this function returns.
+ * Returns the child's thread id, or TID_ERROR if it cannot be created,
+ * FILE cannot be loaded or an action fails. */
+tid_t
+process_spawn (const char *file, char **argv, int argc,
+		const struct spawn_action *actions, size_t action_cnt) {
+	struct spawn_info info = {
+		.parent = thread_current (),
+		.file = file,
+		.argv = argv,
+		.argc = argc,
+		.actions = actions,
+		.action_cnt = action_cnt,
+	};
+	tid_t tid;
+
+	sema_init (&info.loaded, 0);
+	tid = thread_create (file, PRI_DEFAULT, __do_spawn, &info);
+	if (tid == TID_ERROR)
+		return TID_ERROR;
+	sema_down (&info.loaded);
+	return info.success ? tid : TID_ERROR;
+}
+
+/* Gives the current process, being spawned by PARENT, a copy of
+ * PARENT's file descriptor table, and applies the CNT ACTIONS to it in
+ * order.  Returns false if memory runs out, or if an action names a
+ * descriptor out of range or duplicates one that is not open. */
+static bool
+spawn_fd_table (struct thread *parent, const struct spawn_action *actions,
+		size_t cnt) {
+	struct thread *t = thread_current ();
+	struct file **fdt;
+	size_t i;
+
+	if (!fd_table_copy (parent))
+		return false;
+	if (cnt == 0)
+		return true;
+	if (t->fd_table == NULL
+			&& (t->fd_table = palloc_get_page (PAL_ZERO)) == NULL)
+		return false;
+	fdt = t->fd_table;
+
+	for (i = 0; i < cnt; i++) {
+		const struct spawn_action *a = &actions[i];
+
+		if (a->fd < 0 || a->fd >= (int) FD_MAX)
+			return false;
+		if (a->op == SPAWN_CLOSE) {
+			file_close (fdt[a->fd]);
+			fdt[a->fd] = NULL;
+		} else if (a->op == SPAWN_DUP2) {
+			if (a->newfd < 0 || a->newfd >= (int) FD_MAX || fdt[a->fd] == NULL)
+				return false;
+			if (a->newfd == a->fd)
+				continue;
+			file_close (fdt[a->newfd]);
+			fdt[a->newfd] = file_duplicate (fdt[a->fd]);
+			if (fdt[a->newfd] == NULL)
+				return false;
+		} else
+			return false;
+	}
+	return true;
+}
+
+/* A thread function that starts the process that process_spawn()
+ * describes in AUX. */
+static void
+__do_spawn (void *aux) {
+	struct spawn_info *info = aux;
+	struct intr_frame if_;
+	bool success;
+
+#ifdef VM
+	supplemental_page_table_init (&thread_current ()->spt);
+#endif
+	process_init ();
+
+	success = spawn_fd_table (info->parent, info->actions, info->action_cnt)
+		&& process_load (info->file, info->argv, info->argc, &if_);
+
+	/* INFO lives on the parent's stack, and is gone once the parent
+	 * wakes up. */
+	info->success = success;
+	sema_up (&info->loaded);
+	if (!success) {
+		/* The parent sees the failure, so the child exits quietly. */
+		process_cleanup ();
+		thread_exit ();
+	}
+	do_iret (&if_);
+}
+
 void argument_stack(char **argv, int argc, struct intr_frame *if_)
 {
 	char *arg_address[128];
@@ -279,45 +431,127 @@ void argument_stack(char **argv, int argc, struct intr_frame *if_)
 	if_->R.rsi = if_->rsp + 8;	//fake return address + 8
 }
 
+/* Gives the current process, being forked by PARENT, a copy of
+ * PARENT's file descriptor table.  Returns false if memory runs out. */
+static bool
+fd_table_copy (struct thread *parent) {
+	struct thread *t = thread_current ();
+	size_t fd;
+
+	if (parent->fd_table == NULL)
+		return true;
+	t->fd_table = palloc_get_page (PAL_ZERO);
+	if (t->fd_table == NULL)
+		return false;
+	t->fd_idx = parent->fd_idx;
+	for (fd = 0; fd < FD_MAX; fd++)
+		if (parent->fd_table[fd] != NULL
+				&& (t->fd_table[fd] = file_duplicate (parent->fd_table[fd])) == NULL)
+			return false;
+	return true;
+}
+
+/* Closes the files in T's file descriptor table and frees it. */
+static void
+fd_table_free (struct thread *t) {
+	size_t fd;
+
+	if (t->fd_table == NULL)
+		return;
+	for (fd = 0; fd < FD_MAX; fd++)
+		file_close (t->fd_table[fd]);
+	palloc_free_page (t->fd_table);
+	t->fd_table = NULL;
+}
+
+/* What a process leaves behind for its parent, which may wait for it
+ * after it is gone.  It belongs to both, and whichever lets go of it
+ * last frees it. */
+struct child_status {
+	tid_t tid;                  /* The child's thread id. */
+	int exit_status;            /* Set when the child exits. */
+	struct semaphore exited;    /* Upped when the child exits. */
+	int refs;                   /* 2 while both still hold it. */
+	struct list_elem elem;      /* In the parent's CHILDREN. */
+};
+
+/* Gives T, which thread_create() has just made, a status that the
+ * current thread can wait for.  Returns false if memory is short. */
+bool
+process_add_child (struct thread *t) {
+	struct child_status *s = malloc (sizeof *s);
+
+	if (s == NULL)
+		return false;
+	s->tid = t->tid;
+	s->exit_status = -1;
+	sema_init (&s->exited, 0);
+	s->refs = 2;
+	list_push_back (&thread_current ()->children, &s->elem);
+	t->child_status = s;
+	return true;
+}
+
+/* Lets go of S, freeing it if the other side already has. */
+static void
+child_status_release (struct child_status *s) {
+	enum intr_level old_level = intr_disable ();
+	bool last = --s->refs == 0;
+
+	intr_set_level (old_level);
+	if (last)
+		free (s);
+}
+
 /* Waits for thread TID to die and returns its exit status.  If
  * it was terminated by the kernel (i.e. killed due to an
  * exception), returns -1.  If TID is invalid or if it was not a
  * child of the calling process, or if process_wait() has already
  * been successfully called for the given TID, returns -1
- * immediately, without waiting.
- *
- * This function will be implemented in problem 2-2.  For now, it
- * does nothing. */
-/* 
- * 스레드 TID가 종료될 때까지 대기하고, 종료 상태를 반환하는 함수.
- * 만약 커널에 의해 종료된 경우(즉, 예외로 인해 강제 종료된 경우), -1을 반환.
- * TID가 유효하지 않거나 호출한 프로세스의 자식 프로세스가 아니거나, 
- * 또는 주어진 TID에 대해 process_wait()이 이미 성공적으로 호출된 경우, 
- * 즉시 -1을 반환하며 대기하지 않음.
- *
- * 이 함수는 2-2 문제에서 구현될 예정임. 현재는 아무것도 하지 않음.
- */
-
+ * immediately, without waiting. */
 int
-process_wait (tid_t child_tid UNUSED) {
-	/* XXX: Hint) 현재는 핀토스가 initd에서 process_wait()을 호출할 때
-	 * 종료되지 않도록 무한 루프를 추가하는 것을 권장함. */
-	while(1){
-		
+process_wait (tid_t child_tid) {
+	struct list *children = &thread_current ()->children;
+	struct list_elem *e;
+
+	for (e = list_begin (children); e != list_end (children);
+			e = list_next (e)) {
+		struct child_status *s = list_entry (e, struct child_status, elem);
+		int status;
+
+		if (s->tid != child_tid)
+			continue;
+		sema_down (&s->exited);
+		status = s->exit_status;
+		list_remove (&s->elem);
+		child_status_release (s);
+		return status;
 	}
-	return -1;  // 현재는 -1을 반환
+	return -1;
 }
 
 /* Exit the process. This function is called by thread_exit (). */
-/* 프로세스를 종료합니다. 이 함수는 thread_exit()에 의해 호출됩니다. */
 void
 process_exit (void) {
 	struct thread *curr = thread_current ();
-	/* TODO: 여기에서 여러분의 코드를 작성하세요.
-	 * TODO: 프로세스 종료 메시지를 구현하세요 (project2/process_termination.html을 참고하세요).
-	 * TODO: 우리는 여기에서 프로세스 자원 정리를 구현할 것을 권장합니다. */
-	
+
+	/* Kernel threads, and processes that never got to run, have no
+	 * page table and exit quietly. */
+	if (curr->pml4 != NULL)
+		printf ("%s: exit(%d)\n", curr->name, curr->exit_status);
+
+	fd_table_free (curr);
 	process_cleanup ();
+
+	while (!list_empty (&curr->children))
+		child_status_release (list_entry (list_pop_front (&curr->children),
+					struct child_status, elem));
+	if (curr->child_status != NULL) {
+		curr->child_status->exit_status = curr->exit_status;
+		sema_up (&curr->child_status->exited);
+		child_status_release (curr->child_status);
+		curr->child_status = NULL;
+	}
 }
 
 
@@ -328,6 +562,8 @@ process_cleanup (void) {
 
 #ifdef VM
 	supplemental_page_table_kill (&curr->spt);
+	file_close (curr->running_file);
+	curr->running_file = NULL;
 #endif
 
 	uint64_t *pml4;
@@ -438,6 +674,9 @@ static bool load(const char *file_name, struct intr_frame *if_) {
         goto done;
     process_activate(thread_current());  
 		// 현재 스레드의 페이지 디렉터리 활성화
+#ifdef VM
+    t->heap_start = t->heap_end = NULL;
+#endif
 
     /* 실행 파일 열기 */
     file = filesys_open(file_name);  // 실행 파일 열기
@@ -525,6 +764,11 @@ static bool load(const char *file_name, struct intr_frame *if_) {
 
                     if (!load_segment(file, file_page, (void *) mem_page, read_bytes, zero_bytes, writable))  // 세그먼트 로드 실패
                         goto done;
+#ifdef VM
+                    /* The heap starts right after the highest segment. */
+                    if (mem_page + read_bytes + zero_bytes > (uint64_t) t->heap_start)
+                        t->heap_start = t->heap_end = (void *) (mem_page + read_bytes + zero_bytes);
+#endif
                 } else
                     goto done;
                 break;
@@ -541,6 +785,13 @@ static bool load(const char *file_name, struct intr_frame *if_) {
     success = true;  // 로드 성공
 
 done:
+#ifdef VM
+    /* Segments are read in on demand, so keep the file open. */
+    if (success) {
+        t->running_file = file;
+        file = NULL;
+    }
+#endif
     /* 파일을 닫고 성공/실패 여부 반환 */
     file_close(file);
     return success;
@@ -599,6 +850,11 @@ validate_segment (const struct Phdr *phdr, struct file *file) {
 
 /* load() helpers. */
 static bool install_page (void *upage, void *kpage, bool writable);
+static bool install_pages (void *upage, void *const kpages[], size_t cnt,
+		bool writable);
+
+/* Number of segment pages mapped at once by load_segment(). */
+#define LOAD_BATCH 32
 
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
@@ -621,6 +877,12 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
+	/* Pages are loaded into KPAGES and then added to the address
+	 * space LOAD_BATCH at a time, starting at BATCH_UPAGE. */
+	void *kpages[LOAD_BATCH];
+	uint8_t *batch_upage = upage;
+	size_t cnt = 0;
+
 	file_seek (file, ofs);
 	while (read_bytes > 0 || zero_bytes > 0) {
 		/* Do calculate how to fill this page.
@@ -630,30 +892,37 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
 		/* Get a page of memory. */
-		uint8_t *kpage = palloc_get_page (PAL_USER);
+		uint8_t *kpage = palloc_get_page (PAL_USER | PAL_TAG (MEM_VM));
 		if (kpage == NULL)
-			return false;
+			goto fail;
 
 		/* Load this page. */
 		if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes) {
 			palloc_free_page (kpage);
-			return false;
+			goto fail;
 		}
 		memset (kpage + page_read_bytes, 0, page_zero_bytes);
-
-		/* Add the page to the process's address space. */
-		if (!install_page (upage, kpage, writable)) {
-			printf("fail\n");
-			palloc_free_page (kpage);
-			return false;
-		}
+		kpages[cnt++] = kpage;
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+
+		/* Add the batch to the process's address space. */
+		if (cnt == LOAD_BATCH || (read_bytes == 0 && zero_bytes == 0)) {
+			if (!install_pages (batch_upage, kpages, cnt, writable))
+				goto fail;
+			batch_upage = upage;
+			cnt = 0;
+		}
 	}
 	return true;
+
+fail:
+	while (cnt > 0)
+		palloc_free_page (kpages[--cnt]);
+	return false;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the USER_STACK */
@@ -662,7 +931,7 @@ setup_stack (struct intr_frame *if_) {
 	uint8_t *kpage;
 	bool success = false;
 
-	kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+	kpage = palloc_get_page (PAL_USER | PAL_ZERO | PAL_TAG (MEM_VM));
 	if (kpage != NULL) {
 		success = install_page (((uint8_t *) USER_STACK) - PGSIZE, kpage, true);
 		if (success)
@@ -691,18 +960,23 @@ install_page (void *upage, void *kpage, bool writable) {
 	return (pml4_get_page (t->pml4, upage) == NULL
 			&& pml4_set_page (t->pml4, upage, kpage, writable));
 }
+
+/* Adds mappings for the CNT user virtual pages starting at UPAGE to
+ * the kernel virtual addresses in KPAGES[], like install_page(), but
+ * with a single page table walk per page table.
+ * Returns true on success, false if one of the pages is already
+ * mapped or if memory allocation fails. */
+static bool
+install_pages (void *upage, void *const kpages[], size_t cnt, bool writable) {
+	struct thread *t = thread_current ();
+
+	return pml4_map_range (t->pml4, upage, kpages, cnt, writable);
+}
 #else
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool
-lazy_load_segment (struct page *page, void *aux) {
-	/* TODO: Load the segment from the file */
-	/* TODO: This called when the first page fault occurs on address VA. */
-	/* TODO: VA is available when calling this function. */
-}
-
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -724,23 +998,41 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (ofs % PGSIZE == 0);
 
-	while (read_bytes > 0 || zero_bytes > 0) {
+	/* The whole segment is one VMA.  Its pages past the end of the file
+	 * part, as in BSS, need no page of their own: they are plain
+	 * zero-filled memory until touched. */
+	if (!vma_map (&thread_current ()->spt.vmas, upage,
+				upage + read_bytes + zero_bytes, writable ? VM_ANON : VM_FILE,
+				file, ofs, writable))
+		return false;
+
+	while (read_bytes > 0) {
 		/* Do calculate how to fill this page.
 		 * We will read PAGE_READ_BYTES bytes from FILE
 		 * and zero the final PAGE_ZERO_BYTES bytes. */
 		size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
 		size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-		/* TODO: Set up aux to pass information to the lazy_load_segment. */
-		void *aux = NULL;
-		if (!vm_alloc_page_with_initializer (VM_ANON, upage,
-					writable, lazy_load_segment, aux))
+		/* Pages are backed by the file, and shared with every other
+		 * process that runs it, until written: a page of a writable
+		 * segment then gets a private anonymous copy. */
+		struct file_page *aux = malloc (sizeof *aux);
+		if (aux == NULL)
+			return false;
+		aux->file = file;
+		aux->ofs = ofs;
+		aux->read_bytes = page_read_bytes;
+		if (!vm_alloc_page_with_initializer (VM_FILE, upage,
+					writable, NULL, aux)) {
+			free (aux);
 			return false;
+		}
 
 		/* Advance. */
 		read_bytes -= page_read_bytes;
 		zero_bytes -= page_zero_bytes;
 		upage += PGSIZE;
+		ofs += page_read_bytes;
 	}
 	return true;
 }
@@ -751,11 +1043,13 @@ setup_stack (struct intr_frame *if_) {
 	bool success = false;
 	void *stack_bottom = (void *) (((uint8_t *) USER_STACK) - PGSIZE);
 
-	/* TODO: Map the stack on stack_bottom and claim the page immediately.
-	 * TODO: If success, set the rsp accordingly.
-	 * TODO: You should mark the page is stack. */
-	/* TODO: Your code goes here */
-
+	if (vma_map (&thread_current ()->spt.vmas, stack_bottom,
+				(void *) USER_STACK, VM_ANON | VM_STACK, NULL, 0, true)
+			&& vm_alloc_page (VM_ANON | VM_STACK, stack_bottom, true)
+			&& vm_claim_page (stack_bottom)) {
+		if_->rsp = USER_STACK;
+		success = true;
+	}
 	return success;
 }
 #endif /* VM */
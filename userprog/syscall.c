@@ -1,12 +1,28 @@
 #include "userprog/syscall.h"
+#include <memstat.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include "devices/input.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #include "threads/flags.h"
 #include "intrinsic.h"
+#ifdef VM
+#include "vm/vm.h"
+#include "vm/file.h"
+#endif
 
 // 내가 추가한 내용
 
@@ -15,6 +31,30 @@
 void syscall_entry (void);
 void syscall_handler (struct intr_frame *);
 
+static void kill_process (void) NO_RETURN;
+static void sys_exit (int status) NO_RETURN;
+static tid_t sys_fork (const char *name, struct intr_frame *);
+static int sys_exec (const char *cmd_line);
+static struct file *fd_lookup (int fd);
+static int sys_open (const char *file);
+static int sys_filesize (int fd);
+static int sys_read (int fd, void *buffer, unsigned size);
+static int sys_write (int fd, const void *buffer, unsigned size);
+static void sys_seek (int fd, unsigned position);
+static unsigned sys_tell (int fd);
+static void sys_close (int fd);
+static void validate_user_buffer (const void *uaddr, size_t size,
+		bool write);
+static void validate_user_string (const char *us);
+static int copy_in_string (char *dst, const char *us, size_t size);
+static bool sys_get_memstat (struct memstat *);
+static tid_t sys_spawn (const char *file, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt);
+#ifdef VM
+static bool sys_get_procstat (struct procstat *);
+static bool sys_get_faultstat (struct faultstat *);
+#endif
+
 /* System call.
  *
  * Previously system call services was handled by the interrupt handler
@@ -42,11 +82,402 @@ syscall_init (void) {
 }
 
 void
-syscall_handler (struct intr_frame *f UNUSED) {
-	// TODO: Your implementation goes here.
-	printf ("system call!\n");
-   thread_exit();
+syscall_handler (struct intr_frame *f) {
+#ifdef VM
+	/* Page faults taken on behalf of the user need its stack pointer. */
+	thread_current ()->user_rsp = (void *) f->rsp;
+#endif
+
+	switch (f->R.rax) {
+		case SYS_HALT:
+			power_off ();
+		case SYS_EXIT:
+			sys_exit (f->R.rdi);
+		case SYS_FORK:
+			f->R.rax = sys_fork ((const char *) f->R.rdi, f);
+			break;
+		case SYS_EXEC:
+			f->R.rax = sys_exec ((const char *) f->R.rdi);
+			break;
+		case SYS_WAIT:
+			f->R.rax = process_wait (f->R.rdi);
+			break;
+		case SYS_CREATE:
+			validate_user_string ((const char *) f->R.rdi);
+			f->R.rax = filesys_create ((const char *) f->R.rdi, f->R.rsi);
+			break;
+		case SYS_REMOVE:
+			validate_user_string ((const char *) f->R.rdi);
+			f->R.rax = filesys_remove ((const char *) f->R.rdi);
+			break;
+		case SYS_OPEN:
+			f->R.rax = sys_open ((const char *) f->R.rdi);
+			break;
+		case SYS_FILESIZE:
+			f->R.rax = sys_filesize (f->R.rdi);
+			break;
+		case SYS_READ:
+			f->R.rax = sys_read (f->R.rdi, (void *) f->R.rsi, f->R.rdx);
+			break;
+		case SYS_WRITE:
+			f->R.rax = sys_write (f->R.rdi, (const void *) f->R.rsi,
+					f->R.rdx);
+			break;
+		case SYS_SEEK:
+			sys_seek (f->R.rdi, f->R.rsi);
+			break;
+		case SYS_TELL:
+			f->R.rax = sys_tell (f->R.rdi);
+			break;
+		case SYS_CLOSE:
+			sys_close (f->R.rdi);
+			break;
+		case SYS_MEMSTAT:
+			f->R.rax = sys_get_memstat ((struct memstat *) f->R.rdi);
+			break;
+		case SYS_SPAWN:
+			f->R.rax = sys_spawn ((const char *) f->R.rdi,
+					(char *const *) f->R.rsi,
+					(const struct spawn_action *) f->R.rdx, f->R.r10);
+			break;
+#ifdef VM
+		case SYS_BRK:
+			f->R.rax = (uint64_t) vm_brk ((void *) f->R.rdi);
+			break;
+		case SYS_PROCSTAT:
+			f->R.rax = sys_get_procstat ((struct procstat *) f->R.rdi);
+			break;
+		case SYS_FAULTSTAT:
+			f->R.rax = sys_get_faultstat ((struct faultstat *) f->R.rdi);
+			break;
+		case SYS_MADVISE:
+			f->R.rax = vm_madvise ((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_MSYNC:
+			f->R.rax = vm_msync ((void *) f->R.rdi, f->R.rsi, f->R.rdx);
+			break;
+		case SYS_MMAP:
+			f->R.rax = (uint64_t) do_mmap ((void *) f->R.rdi, f->R.rsi,
+					f->R.rdx, fd_lookup (f->R.r10), f->R.r8);
+			break;
+		case SYS_MUNMAP:
+			do_munmap ((void *) f->R.rdi);
+			break;
+#endif
+		default:
+			kill_process ();
+	}
+}
+
+/* Terminates the current process with exit status -1. */
+static void
+kill_process (void) {
+	thread_current ()->exit_status = -1;
+	thread_exit ();
+}
+
+/* Terminates the current process with exit status STATUS. */
+static void
+sys_exit (int status) {
+	thread_current ()->exit_status = status;
+	thread_exit ();
+}
+
+/* Terminates the process unless all SIZE bytes starting at user
+   address UADDR belong to its address space and, if WRITE, are
+   writable by it. */
+static void
+validate_user_buffer (const void *uaddr, size_t size, bool write) {
+	struct thread *t = thread_current ();
+	const uint8_t *end = (const uint8_t *) uaddr + size;
+	const uint8_t *page;
+
+	if (uaddr == NULL || end < (const uint8_t *) uaddr
+			|| !is_user_vaddr (uaddr) || !is_user_vaddr (end - 1))
+		kill_process ();
+
+	for (page = pg_round_down (uaddr); page < end; page += PGSIZE) {
+		uint64_t *pte = pml4e_walk (t->pml4, (uint64_t) page, 0);
+
+		if (pte != NULL && (*pte & PTE_P) && (!write || is_writable (pte)))
+			continue;
+#ifdef VM
+		/* Not mapped yet, or mapped read-only for copy-on-write. */
+		if (vm_user_page_ok (page, write))
+			continue;
+#endif
+		kill_process ();
+	}
+}
+
+/* Terminates the process unless all of the null-terminated string at
+   user address US belongs to its address space. */
+static void
+validate_user_string (const char *us) {
+	size_t i;
+
+	for (i = 0; ; i++) {
+		if (i == 0 || pg_ofs (us + i) == 0)
+			validate_user_buffer (us + i, 1, false);
+		if (us[i] == '\0')
+			return;
+	}
+}
+
+/* Copies the null-terminated string at user address US into the SIZE
+   bytes at DST.  Returns its length, or -1 if it does not fit.
+   Terminates the process if the string runs out of its address
+   space. */
+static int
+copy_in_string (char *dst, const char *us, size_t size) {
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (i == 0 || pg_ofs (us + i) == 0)
+			validate_user_buffer (us + i, 1, false);
+		dst[i] = us[i];
+		if (dst[i] == '\0')
+			return i;
+	}
+	return -1;
+}
+
+/* Starts the executable FILE with the null-terminated argument vector
+   ARGV, after applying the ACTION_CNT file descriptor ACTIONS to the
+   child's copy of the descriptor table.  The strings are copied into
+   one kernel page, which the child reads before process_spawn()
+   returns.  All the user memory is checked before the page is
+   allocated, so that a bad pointer cannot leak it.  Returns the
+   child's tid, or TID_ERROR. */
+static tid_t
+sys_spawn (const char *file, char *const argv[],
+		const struct spawn_action *actions, size_t action_cnt) {
+	struct spawn_action kactions[SPAWN_ACTION_MAX];
+	char *kargv[SPAWN_ARG_MAX];
+	char *page, *p;
+	tid_t tid = TID_ERROR;
+	int argc, i, len;
+
+	if (action_cnt > SPAWN_ACTION_MAX)
+		return TID_ERROR;
+	if (action_cnt > 0) {
+		validate_user_buffer (actions, action_cnt * sizeof *actions,
+				false);
+		memcpy (kactions, actions, action_cnt * sizeof *actions);
+	}
+	validate_user_string (file);
+	for (argc = 0; ; argc++) {
+		validate_user_buffer (&argv[argc], sizeof argv[argc], false);
+		if (argv[argc] == NULL)
+			break;
+		if (argc == SPAWN_ARG_MAX)
+			return TID_ERROR;
+		validate_user_string (argv[argc]);
+	}
+
+	page = palloc_get_page (0);
+	if (page == NULL)
+		return TID_ERROR;
+	len = copy_in_string (page, file, PGSIZE);
+	if (len < 0)
+		goto done;
+	p = page + len + 1;
+	for (i = 0; i < argc; i++) {
+		len = copy_in_string (p, argv[i], page + PGSIZE - p);
+		if (len < 0)
+			goto done;
+		kargv[i] = p;
+		p += len + 1;
+	}
+	tid = process_spawn (page, kargv, argc, kactions, action_cnt);
+
+done:
+	palloc_free_page (page);
+	return tid;
+}
+
+/* Clones the current process, whose user context at the system call is
+   F, as a child named NAME.  Returns the child's tid, or TID_ERROR. */
+static tid_t
+sys_fork (const char *name, struct intr_frame *f) {
+	char kname[sizeof thread_current ()->name];
+
+	validate_user_string (name);
+	strlcpy (kname, name, sizeof kname);
+	return process_fork (kname, f);
+}
+
+/* Replaces the current process with the program and arguments in
+   CMD_LINE.  Returns -1 if CMD_LINE does not fit in a page; if the
+   program cannot be loaded, the process is gone already and exits
+   with status -1. */
+static int
+sys_exec (const char *cmd_line) {
+	char *page;
+
+	validate_user_string (cmd_line);
+	page = palloc_get_page (0);
+	if (page == NULL)
+		return -1;
+	if (copy_in_string (page, cmd_line, PGSIZE) < 0) {
+		palloc_free_page (page);
+		return -1;
+	}
+	process_exec (page);
+	kill_process ();
 }
+
+/* Returns the file open as FD in the current process, or a null
+   pointer if there is none.  Descriptors 0 and 1 stand for the
+   console unless spawn() has put files there. */
+static struct file *
+fd_lookup (int fd) {
+	struct thread *t = thread_current ();
+
+	if (fd < 0 || fd >= (int) FD_MAX || t->fd_table == NULL)
+		return NULL;
+	return t->fd_table[fd];
+}
+
+/* Opens FILE as the lowest free descriptor above the console's, and
+   returns it, or -1 if the file cannot be opened or the table is
+   full. */
+static int
+sys_open (const char *file) {
+	struct thread *t = thread_current ();
+	struct file *f;
+	int fd;
+
+	validate_user_string (file);
+	if (t->fd_table == NULL
+			&& (t->fd_table = palloc_get_page (PAL_ZERO)) == NULL)
+		return -1;
+	for (fd = 2; fd < (int) FD_MAX; fd++)
+		if (t->fd_table[fd] == NULL)
+			break;
+	if (fd == (int) FD_MAX || (f = filesys_open (file)) == NULL)
+		return -1;
+	t->fd_table[fd] = f;
+	return fd;
+}
+
+/* Returns the size in bytes of the file open as FD, or -1. */
+static int
+sys_filesize (int fd) {
+	struct file *f = fd_lookup (fd);
+
+	return f != NULL ? file_length (f) : -1;
+}
+
+/* Reads up to SIZE bytes into BUFFER from the file open as FD, or from
+   the keyboard for descriptor 0.  Returns the number of bytes read, or
+   -1 if FD is not open. */
+static int
+sys_read (int fd, void *buffer, unsigned size) {
+	struct file *f = fd_lookup (fd);
+	uint8_t *p = buffer;
+	unsigned i;
+
+	validate_user_buffer (buffer, size, true);
+	if (f != NULL)
+		return file_read (f, buffer, size);
+	if (fd != STDIN_FILENO)
+		return -1;
+	for (i = 0; i < size; i++)
+		p[i] = input_getc ();
+	return size;
+}
+
+/* Writes SIZE bytes from BUFFER to the file open as FD, or to the
+   console for descriptor 1.  Returns the number of bytes written, or
+   -1 if FD is not open. */
+static int
+sys_write (int fd, const void *buffer, unsigned size) {
+	struct file *f = fd_lookup (fd);
+
+	validate_user_buffer (buffer, size, false);
+	if (f != NULL)
+		return file_write (f, buffer, size);
+	if (fd != STDOUT_FILENO)
+		return -1;
+	putbuf (buffer, size);
+	return size;
+}
+
+/* Moves the position of the file open as FD to POSITION. */
+static void
+sys_seek (int fd, unsigned position) {
+	struct file *f = fd_lookup (fd);
+
+	if (f != NULL)
+		file_seek (f, position);
+}
+
+/* Returns the position of the file open as FD, or 0 if it is not
+   open. */
+static unsigned
+sys_tell (int fd) {
+	struct file *f = fd_lookup (fd);
+
+	return f != NULL ? file_tell (f) : 0;
+}
+
+/* Closes FD, if it is open. */
+static void
+sys_close (int fd) {
+	struct file *f = fd_lookup (fd);
+
+	if (f != NULL) {
+		file_close (f);
+		thread_current ()->fd_table[fd] = NULL;
+	}
+}
+
+/* Copies the kernel memory usage statistics into *UST. */
+static bool
+sys_get_memstat (struct memstat *ust) {
+	struct memstat *st;
+
+	validate_user_buffer (ust, sizeof *ust, true);
+
+	st = malloc (sizeof *st);
+	if (st == NULL)
+		return false;
+	palloc_get_stats (st);
+	malloc_get_stats (st);
+	memcpy (ust, st, sizeof *st);
+	free (st);
+	return true;
+}
+
+#ifdef VM
+/* Copies the current process's virtual memory counters into *UST. */
+static bool
+sys_get_procstat (struct procstat *ust) {
+	struct procstat st;
+
+	validate_user_buffer (ust, sizeof *ust, true);
+	vm_get_procstat (&st);
+	memcpy (ust, &st, sizeof st);
+	return true;
+}
+
+/* Copies the system's page fault statistics into *UST. */
+static bool
+sys_get_faultstat (struct faultstat *ust) {
+	struct faultstat *st;
+
+	validate_user_buffer (ust, sizeof *ust, true);
+	st = malloc (sizeof *st);
+	if (st == NULL)
+		return false;
+	vm_get_faultstat (st);
+	memcpy (ust, st, sizeof *st);
+	free (st);
+	return true;
+}
+#endif
+
 // /* The main system call interface */
 // void
 // syscall_handler (struct intr_frame *f UNUSED) {
@@ -1,6 +1,14 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <bitmap.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #include "devices/disk.h"
 
 /* DO NOT MODIFY BELOW LINE */
@@ -17,36 +25,403 @@ static const struct page_operations anon_ops = {
 	.type = VM_ANON,
 };
 
+/* Swap space.
+ *
+ * The swap disk is divided into page-sized slots, tracked by
+ * SWAP_SLOTS under SWAP_LOCK.  Pages that are evicted together are
+ * given a run of contiguous slots and written with one disk command,
+ * so that swap-out proceeds at the disk's sequential bandwidth.
+ *
+ * A page keeps its slot after it is swapped back in, so that as long
+ * as the page stays clean the copy on disk is still good and the page
+ * can be evicted again without writing it.  Those slots are only worth
+ * keeping while there is room: once more than half of the slots are in
+ * use, pages swapped in give up theirs, and if the swap disk is full,
+ * the pages in memory give up theirs before swap-out fails.
+ *
+ * The pages that share a frame after fork or merging are evicted
+ * together and all get the frame's slot, so a slot has a count of the
+ * pages that refer to it, in SLOT_REFS, and is free once that drops to
+ * 0.  Such pages skip the compressed cache, whose entries belong to a
+ * single page.
+ *
+ * Pages that must be written are first offered to the compressed cache
+ * in zswap.c, and only go to disk if they do not compress.  A page that
+ * fails to compress skips the cache for its next ZSWAP_SKIP evictions.
+ * When the cache fills up, its oldest pages are written to disk,
+ * ZSWAP_WRITEBACK at a time, through the BOUNCE buffers. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+#define ZSWAP_SKIP 4
+#define ZSWAP_WRITEBACK 8
+
+static struct bitmap *swap_slots;
+static uint16_t *slot_refs;             /* Pages that refer to each slot. */
+static struct lock swap_lock;
+static size_t slots_used;               /* Slots allocated. */
+static size_t slots_peak;               /* Most slots ever allocated. */
+static uint64_t write_cnt;              /* Pages written. */
+static uint64_t write_run_cnt;          /* Runs of slots written. */
+static uint64_t skip_cnt;               /* Clean pages not written. */
+static uint64_t read_cnt;               /* Pages read. */
+static uint64_t read_run_cnt;           /* Runs of slots read. */
+static uint64_t zswap_hit_cnt;          /* Pages swapped in from zswap. */
+static uint64_t writeback_cnt;          /* Pages moved from zswap to disk. */
+static uint64_t reclaim_cnt;            /* Slots taken back from pages in memory. */
+static uint8_t *bounce;                 /* ZSWAP_WRITEBACK pages. */
+
+static void swap_slot_free (size_t slot);
+
 /* Initialize the data for anonymous pages */
 void
 vm_anon_init (void) {
-	/* TODO: Set up the swap_disk. */
-	swap_disk = NULL;
+	size_t slot_cnt;
+
+	swap_disk = disk_get (1, 1);
+	slot_cnt = swap_disk != NULL ? disk_size (swap_disk) / SECTORS_PER_SLOT : 0;
+	swap_slots = bitmap_create (slot_cnt);
+	slot_refs = calloc (slot_cnt + 1, sizeof *slot_refs);
+	if (swap_slots == NULL || slot_refs == NULL)
+		PANIC ("vm_anon_init: cannot allocate swap slot bitmap");
+	lock_init (&swap_lock);
+
+	zswap_init ();
+	bounce = palloc_get_multiple (PAL_ASSERT | PAL_TAG (MEM_VM),
+			ZSWAP_WRITEBACK);
 }
 
 /* Initialize the file mapping */
 bool
-anon_initializer (struct page *page, enum vm_type type, void *kva) {
+anon_initializer (struct page *page, enum vm_type type UNUSED, void *kva) {
 	/* Set up the handler */
+	anon_init_page (page);
+
+	/* Anonymous memory starts out zeroed.  An init callback, if any,
+	 * fills it in afterward. */
+	memset (kva, 0, PGSIZE);
+	return true;
+}
+
+/* Turns PAGE, which must be uninitialized and own no data, into an
+ * anonymous page without touching any frame.  Used for a page that
+ * maps a frame whose contents it shares. */
+void
+anon_init_page (struct page *page) {
 	page->operations = &anon_ops;
+	page->anon.slot = SWAP_SLOT_NONE;
+	page->anon.zentry = NULL;
+	page->anon.zskip = 0;
+}
+
+/* Allocates a run of up to CNT contiguous swap slots and stores the
+ * first in *START.  Returns the length of the run, which is as long as
+ * free space allows, or 0 if the swap disk is full. */
+static size_t
+swap_slot_alloc (size_t cnt, size_t *start) {
+	lock_acquire (&swap_lock);
+	size_t i;
+
+	for (; cnt > 0; cnt /= 2) {
+		*start = bitmap_scan_and_flip (swap_slots, 0, cnt, false);
+		if (*start != BITMAP_ERROR)
+			break;
+	}
+	for (i = 0; i < cnt; i++)
+		slot_refs[*start + i] = 1;
+	slots_used += cnt;
+	if (slots_used > slots_peak)
+		slots_peak = slots_used;
+	lock_release (&swap_lock);
+	return cnt;
+}
+
+/* Returns true if more than half of the swap slots are in use, so that
+ * pages in memory should not keep their slots.  SWAP_LOCK must be
+ * held. */
+static bool
+swap_full (void) {
+	return slots_used > bitmap_size (swap_slots) / 2;
+}
+
+/* Drops a reference to SLOT, and returns it to the free slots if that
+ * was the last. */
+static void
+swap_slot_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (slot_refs[slot] > 0);
+	if (--slot_refs[slot] == 0) {
+		bitmap_reset (swap_slots, slot);
+		slots_used--;
+	}
+	lock_release (&swap_lock);
+}
+
+/* Drops the slot of anonymous PAGE, if it has one, so that it is
+ * written out again at its next eviction. */
+void
+anon_drop_slot (struct page *page) {
+	if (page->anon.slot != SWAP_SLOT_NONE) {
+		swap_slot_free (page->anon.slot);
+		page->anon.slot = SWAP_SLOT_NONE;
+	}
+}
+
+/* Gives anonymous PAGE the slot of FROM, which must have one, in place
+ * of its own.  Used when a shared frame is evicted. */
+void
+anon_share_slot (struct page *page, const struct page *from) {
+	ASSERT (from->anon.slot != SWAP_SLOT_NONE);
+
+	if (page->anon.slot == from->anon.slot)
+		return;
+	anon_drop_slot (page);
+	lock_acquire (&swap_lock);
+	ASSERT (slot_refs[from->anon.slot] < UINT16_MAX);
+	slot_refs[from->anon.slot]++;
+	lock_release (&swap_lock);
+	page->anon.slot = from->anon.slot;
+}
 
+/* Gives anonymous PAGE, which has no contents yet, the contents of
+ * anonymous page FROM, which is swapped out, without reading them in:
+ * PAGE shares FROM's slot, or gets a copy of its compressed entry.
+ * Returns false if FROM is not swapped out or zswap has no room. */
+bool
+anon_copy_swapped (struct page *page, const struct page *from) {
+	ASSERT (from->frame == NULL);
+
+	if (from->anon.zentry != NULL)
+		return zswap_copy (page, from);
+	if (from->anon.slot == SWAP_SLOT_NONE)
+		return false;
+	anon_share_slot (page, from);
+	return true;
+}
+
+/* Writes the CNT pages in PAGES, whose contents are at KVAS, to the
+ * CNT slots starting at SLOT, in one sequential transfer. */
+static void
+swap_write_run (struct page *pages[], void *kvas[], size_t cnt,
+		size_t slot) {
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		pages[i]->anon.slot = slot + i;
+		pages[i]->owner->swap_out_cnt++;
+	}
+	disk_write_gather (swap_disk, slot * SECTORS_PER_SLOT,
+			cnt * SECTORS_PER_SLOT, kvas, SECTORS_PER_SLOT);
+
+	lock_acquire (&swap_lock);
+	write_cnt += cnt;
+	write_run_cnt++;
+	lock_release (&swap_lock);
+}
+
+/* Moves the oldest pages in the compressed cache to a run of swap
+ * slots, to make room in the cache.  Returns false if the cache is
+ * empty or the swap disk is full. */
+static bool
+zswap_writeback (void) {
+	struct page *pages[ZSWAP_WRITEBACK];
+	void *kvas[ZSWAP_WRITEBACK];
+	size_t cnt, slot, i;
+
+	cnt = zswap_oldest (pages, ZSWAP_WRITEBACK);
+	if (cnt == 0 || (cnt = swap_slot_alloc (cnt, &slot)) == 0)
+		return false;
+
+	for (i = 0; i < cnt; i++) {
+		kvas[i] = bounce + i * PGSIZE;
+		zswap_load (pages[i], kvas[i]);
+	}
+	swap_write_run (pages, kvas, cnt, slot);
+
+	lock_acquire (&swap_lock);
+	writeback_cnt += cnt;
+	lock_release (&swap_lock);
+	return true;
+}
+
+/* Tries to put PAGE, which must be written out, in the compressed
+ * cache, making room if necessary. */
+static bool
+zswap_try_store (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+	enum zswap_result result;
+
+	if (page->frame->page_cnt > 1)
+		return false;
+	if (anon_page->zskip > 0) {
+		anon_page->zskip--;
+		return false;
+	}
+	result = zswap_store (page, page->frame->kva);
+	if (result == ZSWAP_FULL && zswap_writeback ())
+		result = zswap_store (page, page->frame->kva);
+	if (result == ZSWAP_INCOMPRESSIBLE)
+		anon_page->zskip = ZSWAP_SKIP;
+	return result == ZSWAP_STORED;
 }
 
-/* Swap in the page by read contents from the swap disk. */
+/* Swaps out the CNT anonymous pages in PAGES together, at most
+ * ANON_BATCH_MAX.  Pages that must be written are compressed into
+ * zswap if possible, and otherwise get contiguous slots, so that they
+ * go to disk in as few transfers as possible; pages that still match
+ * their slots are not written.  Either all the pages are swapped out,
+ * or, if the swap disk is too full, none are and false is returned. */
+bool
+anon_swap_out_batch (struct page *pages[], size_t cnt) {
+	struct page *dirty[ANON_BATCH_MAX];
+	void *kvas[ANON_BATCH_MAX];
+	bool was_dirty[ANON_BATCH_MAX];
+	size_t dirty_cnt = 0, disk_cnt = 0, done, i;
+	bool reclaimed = false;
+
+	ASSERT (cnt <= ANON_BATCH_MAX);
+
+	/* Unmap first, so that the owners cannot change the pages while
+	 * they are written, and so that the dirty bits are final. */
+	for (i = 0; i < cnt; i++) {
+		was_dirty[i] = vm_unmap_page (pages[i]);
+		if (pages[i]->anon.slot == SWAP_SLOT_NONE || was_dirty[i])
+			dirty[dirty_cnt++] = pages[i];
+	}
+
+	/* Pages being rewritten give up their old slots.  Those that do
+	 * not go into zswap get a new run. */
+	for (i = 0; i < dirty_cnt; i++) {
+		struct page *page = dirty[i];
+
+		anon_drop_slot (page);
+		if (!zswap_try_store (page)) {
+			dirty[disk_cnt] = page;
+			kvas[disk_cnt++] = page->frame->kva;
+		}
+	}
+
+	for (done = 0; done < disk_cnt; ) {
+		size_t slot;
+		size_t run = swap_slot_alloc (disk_cnt - done, &slot);
+
+		if (run == 0 && !reclaimed) {
+			/* The slots of pages in memory are only an optimization.
+			 * Take them back and try again, once. */
+			size_t cnt = vm_free_swap_slots ();
+
+			reclaimed = true;
+			lock_acquire (&swap_lock);
+			reclaim_cnt += cnt;
+			lock_release (&swap_lock);
+			continue;
+		}
+		if (run == 0) {
+			/* Out of swap.  Put every page back as it was.  The
+			 * pages that lost their slots are now dirty.  A shared
+			 * frame stays read-only. */
+			for (i = 0; i < cnt; i++) {
+				struct page *page = pages[i];
+
+				zswap_drop (page);
+				pml4_set_page (page->owner->pml4, page->va,
+						page->frame->kva,
+						page->writable && page->frame->page_cnt == 1);
+				if (was_dirty[i] || page->anon.slot == SWAP_SLOT_NONE)
+					pml4_set_dirty (page->owner->pml4, page->va, true);
+			}
+			return false;
+		}
+		swap_write_run (dirty + done, kvas + done, run, slot);
+		done += run;
+	}
+
+	lock_acquire (&swap_lock);
+	skip_cnt += cnt - dirty_cnt;
+	lock_release (&swap_lock);
+	return true;
+}
+
+/* Swap in the page by read contents from the swap disk, or from
+ * zswap if it is there.  A slot stays allocated to the page unless swap
+ * is getting full. */
 static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon;
+	bool full;
+
+	if (anon_page->zentry != NULL) {
+		zswap_load (page, kva);
+		lock_acquire (&swap_lock);
+		zswap_hit_cnt++;
+		lock_release (&swap_lock);
+		return true;
+	}
+	ASSERT (anon_page->slot != SWAP_SLOT_NONE);
+
+	disk_read_scatter (swap_disk, anon_page->slot * SECTORS_PER_SLOT,
+			SECTORS_PER_SLOT, &kva, SECTORS_PER_SLOT);
+	page->owner->swap_in_cnt++;
+	lock_acquire (&swap_lock);
+	read_cnt++;
+	read_run_cnt++;
+	full = swap_full ();
+	lock_release (&swap_lock);
+	if (full)
+		anon_drop_slot (page);
+	return true;
+}
+
+/* Reads the CNT anonymous pages in PAGES, which must be on disk in
+ * consecutive slots, into the frames at KVAS, in one sequential
+ * transfer.  Like anon_swap_in(), it leaves the pages their slots
+ * unless swap is getting full.  Used by swap readahead. */
+void
+anon_swap_in_run (struct page *pages[], void *kvas[], size_t cnt) {
+	bool full;
+	size_t i;
+
+	for (i = 0; i < cnt; i++) {
+		ASSERT (pages[i]->anon.zentry == NULL);
+		ASSERT (pages[i]->anon.slot == pages[0]->anon.slot + i);
+		pages[i]->owner->swap_in_cnt++;
+	}
+	disk_read_scatter (swap_disk, pages[0]->anon.slot * SECTORS_PER_SLOT,
+			cnt * SECTORS_PER_SLOT, kvas, SECTORS_PER_SLOT);
+
+	lock_acquire (&swap_lock);
+	read_cnt += cnt;
+	read_run_cnt++;
+	full = swap_full ();
+	lock_release (&swap_lock);
+	if (full)
+		for (i = 0; i < cnt; i++)
+			anon_drop_slot (pages[i]);
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool
 anon_swap_out (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	return anon_swap_out_batch (&page, 1);
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void
 anon_destroy (struct page *page) {
-	struct anon_page *anon_page = &page->anon;
+	vm_free_frame (page);
+	zswap_drop (page);
+	anon_drop_slot (page);
+}
+
+/* Prints swap statistics. */
+void
+anon_print_stats (void) {
+	printf ("Swap: %zu of %zu slots in use (peak %zu), "
+			"%llu pages written in %llu runs, %llu clean pages skipped, "
+			"%llu pages read in %llu runs\n",
+			slots_used, bitmap_size (swap_slots), slots_peak,
+			write_cnt, write_run_cnt, skip_cnt, read_cnt, read_run_cnt);
+	printf ("Swap: %llu pages swapped in from zswap, "
+			"%llu written back from zswap to disk, "
+			"%llu slots taken back from pages in memory\n",
+			zswap_hit_cnt, writeback_cnt, reclaim_cnt);
+	zswap_print_stats ();
 }
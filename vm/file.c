@@ -1,5 +1,8 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
@@ -21,38 +24,89 @@ vm_file_init (void) {
 
 /* Initialize the file backed page */
 bool
-file_backed_initializer (struct page *page, enum vm_type type, void *kva) {
+file_backed_initializer (struct page *page, enum vm_type type UNUSED,
+		void *kva) {
+	struct file_page *aux = page->uninit.aux;
+
 	/* Set up the handler */
-	page->operations = &file_ops;
+	file_init_page (page, aux);
+	free (aux);
+	return file_backed_swap_in (page, kva);
+}
 
-	struct file_page *file_page = &page->file;
+/* Turns PAGE, which must be uninitialized, into a page backed by the
+ * file described by INFO, without touching any frame.  Used for a page
+ * that maps a frame whose contents another page already read. */
+void
+file_init_page (struct page *page, const struct file_page *info) {
+	page->operations = &file_ops;
+	page->file = *info;
 }
 
 /* Swap in the page by read contents from the file. */
 static bool
 file_backed_swap_in (struct page *page, void *kva) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (file_read_at (file_page->file, kva, file_page->read_bytes,
+				file_page->ofs) != (off_t) file_page->read_bytes)
+		return false;
+	memset ((uint8_t *) kva + file_page->read_bytes, 0,
+			PGSIZE - file_page->read_bytes);
+	return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  Only a
+ * writable page of a mapping that has been written since it was read
+ * needs to be written; otherwise the file already holds its contents
+ * and the page only has to be unmapped. */
 static bool
 file_backed_swap_out (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	struct file_page *file_page = &page->file;
+
+	if (vm_unmap_page (page) && page->writable)
+		file_write_at (file_page->file, page->frame->kva,
+				file_page->read_bytes, file_page->ofs);
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
 static void
 file_backed_destroy (struct page *page) {
-	struct file_page *file_page UNUSED = &page->file;
+	vm_free_frame (page);
 }
 
-/* Do the mmap */
+/* Do the mmap.  Maps LENGTH bytes of FILE, starting at OFFSET, at
+ * ADDR in the current process.  No page is read until it is touched:
+ * the mapping is recorded as a VMA, which holds its own reference to
+ * FILE.  Returns ADDR, or NULL if the arguments are invalid or the
+ * range overlaps an existing mapping. */
 void *
 do_mmap (void *addr, size_t length, int writable,
 		struct file *file, off_t offset) {
+	uint8_t *start = addr, *end = start + length;
+	struct file *f;
+
+	if (addr == NULL || pg_ofs (addr) != 0 || offset < 0
+			|| pg_ofs (offset) != 0 || length == 0 || end < start
+			|| !is_user_vaddr (start) || !is_user_vaddr (end - 1)
+			|| file == NULL || file_length (file) == 0)
+		return NULL;
+	end = pg_round_up (end);
+
+	f = file_reopen (file);
+	if (f == NULL)
+		return NULL;
+	if (!vm_map_file (start, end, f, offset, writable)) {
+		file_close (f);
+		return NULL;
+	}
+	return addr;
 }
 
-/* Do the munmap */
+/* Do the munmap.  Removes the mapping made by do_mmap() at ADDR,
+ * writing back its dirty pages first. */
 void
 do_munmap (void *addr) {
+	vm_unmap_mapping (addr);
 }
@@ -0,0 +1,190 @@
+/* radix.c: Radix tree keyed by user page number. */
+
+#include "vm/radix.h"
+#include <debug.h>
+#include "threads/malloc.h"
+
+/* The tree always has RADIX_LEVELS levels of nodes with RADIX_FANOUT
+ * slots each, indexed by successive RADIX_BITS-bit groups of the key,
+ * most significant first, like the levels of a page table.  Slots of
+ * the last level hold the values and slots of the others hold child
+ * nodes.  Nodes are allocated as keys are inserted and freed as soon as
+ * they become empty, so that walks only visit populated parts of the
+ * key space, and a lookup takes RADIX_LEVELS pointer hops.  A node is
+ * 512 bytes, one of malloc()'s block sizes. */
+
+#define RADIX_BITS 6
+#define RADIX_FANOUT (1 << RADIX_BITS)
+#define RADIX_LEVELS 5
+
+struct radix_node {
+	void *slots[RADIX_FANOUT];
+};
+
+/* Returns the index in a node at LEVEL of the slot for KEY. */
+static size_t
+slot_index (uint64_t key, int level) {
+	return (key >> ((RADIX_LEVELS - 1 - level) * RADIX_BITS))
+		& (RADIX_FANOUT - 1);
+}
+
+/* Returns the number of keys that one slot of a node at LEVEL covers. */
+static uint64_t
+slot_span (int level) {
+	return (uint64_t) 1 << ((RADIX_LEVELS - 1 - level) * RADIX_BITS);
+}
+
+/* Initializes R as an empty tree. */
+void
+radix_init (struct radix *r) {
+	r->root = NULL;
+	r->cnt = 0;
+	r->node_cnt = 0;
+}
+
+/* Returns the value for KEY in R, or a null pointer if there is
+ * none. */
+void *
+radix_lookup (const struct radix *r, uint64_t key) {
+	struct radix_node *node = r->root;
+	int level;
+
+	ASSERT (key < RADIX_KEY_MAX);
+
+	for (level = 0; node != NULL && level < RADIX_LEVELS - 1; level++)
+		node = node->slots[slot_index (key, level)];
+	return node != NULL ? node->slots[slot_index (key, RADIX_LEVELS - 1)]
+		: NULL;
+}
+
+/* Allocates an empty node for R. */
+static struct radix_node *
+node_alloc (struct radix *r) {
+	struct radix_node *node = calloc (1, sizeof *node);
+
+	if (node != NULL)
+		r->node_cnt++;
+	return node;
+}
+
+/* Adds VALUE, which must not be null, to R under KEY.  Returns false if
+ * KEY already has a value or memory is short. */
+bool
+radix_insert (struct radix *r, uint64_t key, void *value) {
+	struct radix_node *node;
+	void **slot;
+	int level;
+
+	ASSERT (key < RADIX_KEY_MAX);
+	ASSERT (value != NULL);
+
+	if (r->root == NULL && (r->root = node_alloc (r)) == NULL)
+		return false;
+	node = r->root;
+	for (level = 0; level < RADIX_LEVELS - 1; level++) {
+		slot = &node->slots[slot_index (key, level)];
+		if (*slot == NULL && (*slot = node_alloc (r)) == NULL)
+			return false;
+		node = *slot;
+	}
+
+	slot = &node->slots[slot_index (key, RADIX_LEVELS - 1)];
+	if (*slot != NULL)
+		return false;
+	*slot = value;
+	r->cnt++;
+	return true;
+}
+
+/* Removes the values with keys in [START, END) from the subtree of R
+ * at NODE, which is at LEVEL and whose first key is BASE, and passes
+ * each to DESTROY, if it is not null.  Frees the nodes under NODE that
+ * become empty, and returns true if NODE itself is empty. */
+static bool
+remove_range (struct radix *r, struct radix_node *node, int level,
+		uint64_t base, uint64_t start, uint64_t end,
+		radix_destroy_func *destroy, void *aux) {
+	uint64_t span = slot_span (level);
+	bool empty = true;
+	size_t i;
+
+	for (i = 0; i < RADIX_FANOUT; i++) {
+		uint64_t first = base + i * span;
+		void *value = node->slots[i];
+
+		if (value == NULL)
+			continue;
+		if (first + span <= start || first >= end)
+			empty = false;
+		else if (level == RADIX_LEVELS - 1) {
+			node->slots[i] = NULL;
+			r->cnt--;
+			if (destroy != NULL)
+				destroy (first, value, aux);
+		} else if (remove_range (r, value, level + 1, first, start, end,
+					destroy, aux)) {
+			node->slots[i] = NULL;
+			free (value);
+			r->node_cnt--;
+		} else
+			empty = false;
+	}
+	return empty;
+}
+
+/* Removes the value for KEY from R and returns it, or returns a null
+ * pointer if there is none. */
+void *
+radix_remove (struct radix *r, uint64_t key) {
+	void *value = radix_lookup (r, key);
+
+	if (value != NULL)
+		radix_remove_range (r, key, key + 1, NULL, NULL);
+	return value;
+}
+
+/* Removes the values with keys in [START, END) from R, and passes each
+ * to DESTROY, if it is not null, after it is out of the tree.  Visits
+ * only the nodes that hold such values. */
+void
+radix_remove_range (struct radix *r, uint64_t start, uint64_t end,
+		radix_destroy_func *destroy, void *aux) {
+	if (r->root != NULL
+			&& remove_range (r, r->root, 0, 0, start, end, destroy, aux)) {
+		free (r->root);
+		r->root = NULL;
+		r->node_cnt--;
+	}
+}
+
+/* Calls FUNC for the values under NODE, at LEVEL and with first key
+ * BASE, with keys in [START, END), in key order.  Returns false if FUNC
+ * did. */
+static bool
+walk (struct radix_node *node, int level, uint64_t base, uint64_t start,
+		uint64_t end, radix_walk_func *func, void *aux) {
+	uint64_t span = slot_span (level);
+	size_t i;
+
+	for (i = 0; i < RADIX_FANOUT; i++) {
+		uint64_t first = base + i * span;
+		void *value = node->slots[i];
+
+		if (value == NULL || first + span <= start || first >= end)
+			continue;
+		if (level == RADIX_LEVELS - 1 ? !func (first, value, aux)
+				: !walk (value, level + 1, first, start, end, func, aux))
+			return false;
+	}
+	return true;
+}
+
+/* Calls FUNC for each value in R with a key in [START, END), in key
+ * order, until FUNC returns false.  Returns false if FUNC did.  FUNC
+ * must not add values to R or remove them. */
+bool
+radix_walk (const struct radix *r, uint64_t start, uint64_t end,
+		radix_walk_func *func, void *aux) {
+	return r->root == NULL
+		|| walk (r->root, 0, 0, start, end, func, aux);
+}
@@ -1,9 +1,235 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <madvise.h>
+#include <memstat.h>
+#include <msync.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "intrinsic.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
 
+/* Frame table.
+ *
+ * Every page of the user pool that holds a user page has a struct frame,
+ * found through FRAME_TABLE by its index in the pool.  The table, and
+ * the list of pages that map each frame, are protected by FRAME_LOCK.
+ * A frame is pinned while the kernel accesses it through its kernel
+ * address, that is, while it is being filled in or copied; pinned
+ * frames are never moved.
+ *
+ * After fork, a frame may be mapped by several pages, read-only, until
+ * one of them is written; see vm_handle_wp().  Such a frame is evicted
+ * as a whole, and all its pages then refer to the same swap slot. */
+static struct lock frame_lock;
+static struct frame **frame_table;
+static uint8_t *frame_base;             /* First page of the user pool. */
+static size_t frame_cnt;                /* Pages in the user pool. */
+
+/* Serializes page faults, claims and page table teardown against
+ * eviction, so that a page is never brought back in while it is still
+ * being written out, nor destroyed while another process evicts it. */
+static struct lock vm_lock;
+
+/* Clock eviction.  CLOCK_HAND is the index in FRAME_TABLE that the
+ * next search for a victim starts at.  Protected by FRAME_LOCK. */
+static size_t clock_hand;
+static uint64_t evict_cnt;              /* Frames evicted. */
+static uint64_t evict_clean_cnt;        /* ...that did not need writing. */
+static uint64_t scan_cnt;               /* Frames examined for eviction. */
+static uint64_t scan_max;               /* Most frames examined at once. */
+static uint64_t evict_text_cnt;         /* Text cache frames evicted. */
+
+/* The zero frame.  A read fault on a zero-filled anonymous page that
+ * has never been touched maps this frame, read-only, instead of a
+ * fresh zeroed one.  The first write gives the page a private frame
+ * through vm_handle_wp().  The zero frame comes from the kernel pool,
+ * so it is not in the frame table and is never moved or evicted.
+ * Statistics are protected by VM_LOCK. */
+static struct frame zero_frame;
+static uint64_t zero_map_cnt;           /* Read faults mapped to it. */
+static uint64_t zero_write_cnt;         /* Writes that replaced it. */
+
+/* Text cache.  Pages of executables are backed by the file, and all
+ * the pages that map the same page of the same executable, in any
+ * process, map the same frame, found in TEXT_CACHE by inode, offset
+ * and length.  Such a frame is evicted as a whole, by unmapping all of
+ * its pages, since the file still holds its contents.  Pages of
+ * writable segments map it read-only too, until their first write
+ * gives them a private anonymous copy.  TEXT_CACHE is protected by
+ * FRAME_LOCK and the statistics by VM_LOCK. */
+static struct hash text_cache;
+static uint64_t text_share_cnt;         /* Faults that mapped a cached frame. */
+static uint64_t text_read_cnt;          /* Faults that read the file. */
+static uint64_t text_copy_cnt;          /* Data pages copied from a frame. */
+static uint64_t text_private_cnt;       /* Data pages read privately. */
+
+/* Fault-around.  A fault on a page whose contents come from a file
+ * also maps the other such pages in the aligned window of
+ * FAULT_AROUND_PAGES pages around it, as long as free frames last.
+ * Statistics are protected by VM_LOCK. */
+size_t fault_around_pages = 8;
+static uint64_t fault_cnt;              /* Page faults handled. */
+static uint64_t around_fault_cnt;       /* ...that faulted around. */
+static uint64_t around_cnt;             /* Pages mapped around faults. */
+static uint64_t around_used_cnt;        /* ...later found accessed. */
+
+/* Access pattern advice given with madvise().  MADV_SEQUENTIAL pages
+ * fault around SEQ_AROUND_SCALE times as many pages, all of them ahead
+ * of the fault, and clear the accessed bits of as many pages behind it,
+ * so that the clock takes those first.  Statistics are protected by
+ * VM_LOCK. */
+#define SEQ_AROUND_SCALE 4
+static uint64_t behind_cnt;             /* Pages aged behind faults. */
+static uint64_t willneed_cnt;           /* Pages read in by MADV_WILLNEED. */
+static uint64_t dontneed_cnt;           /* Frames freed by MADV_DONTNEED. */
+static uint64_t populate_cnt;           /* Pages faulted by MADV_POPULATE. */
+
+/* Swap readahead.  A fault that reads a page from the swap disk also
+ * reads the pages next to it in the process, within an aligned window,
+ * that are on disk in the slots next to its own, in the same transfer.
+ * They are not mapped until they are touched, so that each fault on one
+ * counts as a hit.  The window of a process doubles at its next swap
+ * read if one of its pages read ahead has been hit since the last, and
+ * halves otherwise.  The counters are protected by VM_LOCK, except
+ * RA_MISS_CNT, which is protected by FRAME_LOCK. */
+#define SWAP_RA_MIN 2
+#define SWAP_RA_INIT 4
+#define SWAP_RA_MAX 16
+static uint64_t ra_read_cnt;            /* Swap reads that read ahead. */
+static uint64_t ra_page_cnt;            /* Pages read ahead. */
+static uint64_t ra_hit_cnt;             /* ...that were touched. */
+static uint64_t ra_miss_cnt;            /* ...that lost their frames first. */
+
+/* Copy-on-write statistics.  Protected by VM_LOCK. */
+static uint64_t cow_share_cnt;          /* Pages shared by fork. */
+static uint64_t cow_swap_cnt;           /* ...of them swapped out. */
+static uint64_t cow_copy_cnt;           /* Pages copied on write. */
+static uint64_t cow_reuse_cnt;          /* Writes by a frame's last page. */
+
+/* Fault statistics.  Every fault is counted in its class, both for the
+ * system in FAULT_STATS and for the faulting process, with its latency
+ * in CPU cycles, from the fault handler's entry to its return, waiting
+ * for VM_LOCK included.  Protected by VM_LOCK.  Processes may read
+ * their own counters through int 0x43; see fault_inspect(). */
+static struct fault_class_stat fault_stats[FAULT_CLASS_CNT];
+
+static const char *fault_class_names[FAULT_CLASS_CNT] = {
+	"lazy", "zero", "swap", "file", "stack", "cow", "invalid",
+};
+
+/* Page-fault-frequency frame quotas.  A process may keep FRAME_QUOTA
+ * frames before the clock prefers its pages over other processes'.  Its
+ * fault rate is measured at its faults, over windows of at least
+ * PFF_WINDOW ticks: above PFF_HIGH faults per window, a process that
+ * has used up its quota gets PFF_STEP more frames, as long as all the
+ * quotas still fit in the user pool; below PFF_LOW, its quota shrinks
+ * to the frames it holds.  A process gets PFF_MIN frames at its first
+ * fault.  QUOTA_TOTAL and the statistics are protected by VM_LOCK, and
+ * the quotas and OVER_QUOTA_CNT by FRAME_LOCK as well. */
+#define PFF_WINDOW (TIMER_FREQ / 10)
+#define PFF_HIGH 32
+#define PFF_LOW 4
+#define PFF_MIN 16
+#define PFF_STEP 16
+bool pff_enabled = true;
+static size_t quota_total;              /* Sum of all quotas. */
+static size_t over_quota_cnt;           /* Processes over their quota. */
+static uint64_t quota_grow_cnt;         /* Quotas raised. */
+static uint64_t quota_shrink_cnt;       /* Quotas cut. */
+static uint64_t over_victim_cnt;        /* Victims taken over quota. */
+
+/* Same-page merging.  A daemon scans MERGE_PAGES_PER_PASS frames of
+ * the frame table every MERGE_INTERVAL ticks, and merges anonymous
+ * frames with identical contents into one frame, mapped read-only and
+ * copied again on the next write, as after fork.  A merged frame stays
+ * evictable, as a shared anonymous frame.  0 pages per pass disables
+ * it.  Statistics are protected by VM_LOCK. */
+size_t merge_pages_per_pass = 64;
+int64_t merge_interval = TIMER_FREQ / 10;
+static uint64_t merge_pass_cnt;         /* Passes run. */
+static uint64_t merge_pause_cnt;        /* ...cut short by ready threads. */
+static uint64_t merge_scan_cnt;         /* Frames examined. */
+static uint64_t merge_volatile_cnt;     /* ...changed since the last scan. */
+static uint64_t merge_cnt;              /* Frames merged away. */
+static uint64_t merge_zero_cnt;         /* ...into the zero frame. */
+
+/* Most frames that one eviction frees. */
+#define EVICT_BATCH 8
+
+/* Background reclaim.  When an allocation leaves fewer than
+ * KSWAPD_LOW free pages in the user pool, the kswapd thread evicts
+ * frames, a batch at a time, until KSWAPD_HIGH are free, so that
+ * faults seldom have to evict themselves.  Before evicting, it writes
+ * back the dirty file-backed pages in the KSWAPD_HIGH frames ahead of
+ * the clock hand, so that the clock finds them clean.  KSWAPD_WOKEN
+ * and the statistics are protected by VM_LOCK. */
+static size_t kswapd_low;               /* Free pages that wake kswapd. */
+static size_t kswapd_high;              /* Free pages that it stops at. */
+static struct semaphore kswapd_sema;    /* Upped to wake kswapd. */
+static bool kswapd_woken;               /* KSWAPD_SEMA upped, not served? */
+static uint64_t direct_reclaim_cnt;     /* Allocations that evicted. */
+static uint64_t direct_frame_cnt;       /* ...frames they evicted. */
+static uint64_t kswapd_run_cnt;         /* Times kswapd was woken. */
+static uint64_t kswapd_frame_cnt;       /* Frames it evicted. */
+static uint64_t kswapd_clean_cnt;       /* Pages it wrote back. */
+
+/* Write-back of file mappings.  A writable page of a mapping made by
+ * do_mmap() is written back to its file when it is evicted, unmapped or
+ * synced with msync(), if it has been written since.  The dirty pages
+ * are written WB_BATCH at a time, in file order, and the pages of a
+ * batch that are adjacent in the same file go to disk in one transfer.
+ * MS_ASYNC wakes the kflushd thread, which writes back the dirty pages
+ * of all the mappings in the frame table.  FLUSH_WOKEN and the
+ * statistics are protected by VM_LOCK. */
+#define WB_BATCH 16
+static struct semaphore flush_sema;     /* Upped to wake kflushd. */
+static bool flush_woken;                /* FLUSH_SEMA upped, not served? */
+static uint64_t wb_page_cnt;            /* Pages written back. */
+static uint64_t wb_run_cnt;             /* ...in this many transfers. */
+static uint64_t msync_cnt;              /* Calls to msync(). */
+static uint64_t flush_run_cnt;          /* Times kflushd was woken. */
+
+/* Transparent huge pages.  A fault in a 2 MB aligned block of
+ * zero-filled anonymous memory that has no pages yet maps the whole
+ * block with one huge page, if an aligned run of free frames is
+ * available.  Huge pages are split into ordinary pages when part of one
+ * is freed, when the process forks, and when the clock finds one idle.
+ * Protected by VM_LOCK. */
+bool thp_enabled = true;
+static size_t thp_cnt;                  /* Huge pages in use. */
+static uint64_t thp_fault_cnt;          /* Faults in blocks that qualified. */
+static uint64_t thp_alloc_cnt;          /* ...that mapped a huge page. */
+static uint64_t thp_split_cnt;          /* Huge pages split. */
+static uint64_t thp_free_cnt;           /* Huge pages freed whole. */
+
+/* Compaction daemon.  Every COMPACT_INTERVAL ticks, it makes sure that
+ * the user pool has a run of COMPACT_RUN free pages, which is long
+ * enough to hold an aligned huge page. */
+#define COMPACT_INTERVAL TIMER_FREQ
+static size_t compact_run;
+
+static void frame_table_init (void);
+static void zero_frame_init (void);
+static struct frame *frame_alloc (void);
+static void frame_free (struct frame *frame);
+static bool vm_migrate_frame (void *from, void *to);
+static void compact_daemon (void *aux);
+static void merge_daemon (void *aux);
+static void kswapd (void *aux);
+static void kswapd_clean (void);
+static void flush_daemon (void *aux);
+static void fault_inspect (struct intr_frame *f);
+static hash_hash_func text_hash;
+static hash_less_func text_less;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void
@@ -15,7 +241,9 @@ vm_init (void) {
 #endif
 	register_inspect_intr ();
 	/* DO NOT MODIFY UPPER LINES. */
-	/* TODO: Your code goes here. */
+	intr_register_int (0x43, 3, INTR_OFF, fault_inspect, "Inspect Page Faults");
+	frame_table_init ();
+	zero_frame_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -33,9 +261,487 @@ page_get_type (struct page *page) {
 }
 
 /* Helpers */
-static struct frame *vm_get_victim (void);
+static struct frame *vm_get_victim (struct huge_page **split);
+static bool huge_split (struct huge_page *h);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_claim_frame (struct page *page, struct frame *frame);
+static void check_around (struct page *page);
 static struct frame *vm_evict_frame (void);
+static bool text_swap_out (struct frame *frame);
+static void text_uncache (struct frame *frame);
+
+/* Sets up the frame table and hooks user pool compaction up to it. */
+static void
+frame_table_init (void) {
+	lock_init (&frame_lock);
+	lock_init (&vm_lock);
+	frame_cnt = palloc_user_pool ((void **) &frame_base);
+	frame_table = calloc (frame_cnt, sizeof *frame_table);
+	if (frame_table == NULL)
+		PANIC ("vm_init: cannot allocate frame table");
+	hash_init (&text_cache, text_hash, text_less, NULL);
+
+	palloc_set_migrate (vm_migrate_frame);
+	compact_run = HUGE_PAGE_CNT
+		+ (HUGE_PAGE_CNT - pg_no (frame_base) % HUGE_PAGE_CNT) % HUGE_PAGE_CNT;
+	thread_create ("kcompactd", PRI_MIN, compact_daemon, NULL);
+	thread_create ("ksmd", PRI_MIN, merge_daemon, NULL);
+
+	kswapd_low = frame_cnt / 32 > EVICT_BATCH ? frame_cnt / 32 : EVICT_BATCH;
+	kswapd_high = kswapd_low * 2;
+	sema_init (&kswapd_sema, 0);
+	thread_create ("kswapd", PRI_DEFAULT, kswapd, NULL);
+	sema_init (&flush_sema, 0);
+	thread_create ("kflushd", PRI_DEFAULT, flush_daemon, NULL);
+}
+
+/* Sets up the zero frame. */
+static void
+zero_frame_init (void) {
+	zero_frame.kva = palloc_get_page (PAL_ASSERT | PAL_ZERO | PAL_TAG (MEM_VM));
+	list_init (&zero_frame.pages);
+	zero_frame.page_cnt = 0;
+	zero_frame.pinned = true;
+}
+
+/* Returns the frame table entry for the user pool page at KVA. */
+static struct frame **
+frame_slot (const void *kva) {
+	size_t idx = ((const uint8_t *) kva - frame_base) / PGSIZE;
+
+	ASSERT (idx < frame_cnt);
+	return &frame_table[idx];
+}
+
+/* Returns the page that maps FRAME, which must not be shared. */
+static struct page *
+frame_page (struct frame *frame) {
+	ASSERT (frame->page_cnt == 1);
+	return list_entry (list_front (&frame->pages), struct page, frame_elem);
+}
+
+/* Returns the first of the pages that map FRAME, which must have
+ * one. */
+static struct page *
+frame_first_page (struct frame *frame) {
+	ASSERT (frame->page_cnt > 0);
+	return list_entry (list_front (&frame->pages), struct page, frame_elem);
+}
+
+/* Returns true if every page that maps FRAME is anonymous. */
+static bool
+frame_all_anon (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e))
+		if (page_get_type (list_entry (e, struct page, frame_elem)) != VM_ANON)
+			return false;
+	return true;
+}
+
+/* Updates whether T holds more frames than its quota.  FRAME_LOCK must
+ * be held. */
+static void
+quota_check (struct thread *t) {
+	bool over = t->frame_quota != 0 && t->rss > t->frame_quota;
+
+	if (over != t->over_quota) {
+		t->over_quota = over;
+		if (over)
+			over_quota_cnt++;
+		else
+			over_quota_cnt--;
+	}
+}
+
+/* Adds PAGE to the pages that map FRAME. */
+static void
+frame_link (struct frame *frame, struct page *page) {
+	lock_acquire (&frame_lock);
+	list_push_back (&frame->pages, &page->frame_elem);
+	frame->page_cnt++;
+	page->frame = frame;
+	if (frame != &zero_frame) {
+		page->owner->rss++;
+		quota_check (page->owner);
+	}
+	lock_release (&frame_lock);
+}
+
+/* Removes PAGE from the pages that map its frame. */
+static void
+frame_unlink (struct page *page) {
+	struct frame *frame = page->frame;
+
+	lock_acquire (&frame_lock);
+	list_remove (&page->frame_elem);
+	frame->page_cnt--;
+	page->frame = NULL;
+	if (page->readahead) {
+		page->readahead = false;
+		ra_miss_cnt++;
+	}
+	if (frame != &zero_frame) {
+		page->owner->rss--;
+		quota_check (page->owner);
+	}
+	lock_release (&frame_lock);
+}
+
+/* Returns true if every page that maps FRAME still has a page table. */
+static bool
+frame_mapped (struct frame *frame) {
+	struct list_elem *e;
+
+	if (frame->page_cnt == 0)
+		return false;
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e))
+		if (list_entry (e, struct page, frame_elem)->owner->pml4 == NULL)
+			return false;
+	return true;
+}
+
+/* Pins or unpins FRAME. */
+static void
+frame_set_pinned (struct frame *frame, bool pinned) {
+	lock_acquire (&frame_lock);
+	frame->pinned = pinned;
+	lock_release (&frame_lock);
+}
+
+/* Moves the frame at FROM to the free user pool page TO, if it is a
+ * frame and is not pinned.  The copy and the page table updates are
+ * done with interrupts off, so the owners cannot touch the page in
+ * between.  Code that holds VM_LOCK may use a frame's kernel address
+ * without pinning it, so nothing moves while VM_LOCK is held by
+ * someone else; the frame is just skipped then.  Called by
+ * palloc_compact(). */
+static bool
+vm_migrate_frame (void *from, void *to) {
+	struct frame **slot, *frame;
+	bool moved = false;
+
+	if (!lock_try_acquire (&vm_lock))
+		return false;
+	lock_acquire (&frame_lock);
+	slot = frame_slot (from);
+	frame = *slot;
+	if (frame != NULL && !frame->pinned && frame_mapped (frame)) {
+		enum intr_level old_level = intr_disable ();
+		struct list_elem *e;
+
+		memcpy (to, from, PGSIZE);
+		for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+			pml4_remap_page (page->owner->pml4, page->va, to);
+		}
+		frame->kva = to;
+		*frame_slot (to) = frame;
+		*slot = NULL;
+		moved = true;
+		intr_set_level (old_level);
+	}
+	lock_release (&frame_lock);
+	lock_release (&vm_lock);
+	return moved;
+}
+
+/* Keeps a run of free pages available in the user pool, for requests
+ * that need physically contiguous user pages. */
+static void
+compact_daemon (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (COMPACT_INTERVAL);
+		palloc_compact (compact_run);
+	}
+}
+
+/* Same-page merging.
+ *
+ * Each pass hashes the contents of the next frames of the frame table.
+ * A frame whose hash changed since the previous sweep is being written
+ * and is left alone.  A stable one is looked up by its hash in
+ * MERGE_HASHES, which remembers the stable frames seen so far in this
+ * sweep of the table; if an earlier frame has the same hash, and turns
+ * out to have the same contents once both are write-protected, all the
+ * pages of the later frame move over to it.  Zero-filled frames merge
+ * into the zero frame.  The clock evicts a merged frame as a whole,
+ * like one that fork left shared, so merging never takes frames out of
+ * reach of eviction; see share_unmap().  MERGE_HASHES starts over with each sweep, so
+ * that it never refers to frames that went away long ago. */
+
+/* An entry in MERGE_HASHES. */
+struct merge_entry {
+	uint64_t checksum;          /* Hash of the frame's contents. */
+	size_t idx;                 /* Index in FRAME_TABLE, plus 1; 0 if free. */
+};
+
+static struct merge_entry *merge_hashes;
+static size_t merge_hash_cnt;           /* Entries, a power of 2. */
+static size_t merge_hash_used;          /* Entries in use. */
+static size_t merge_cursor;             /* Next index in FRAME_TABLE. */
+static uint64_t zero_checksum;          /* Hash of a zero-filled page. */
+
+/* Returns a hash of the contents of the page at KVA. */
+static uint64_t
+page_checksum (const void *kva) {
+	const uint64_t *p = kva;
+	uint64_t h = 0;
+	size_t i;
+
+	for (i = 0; i < PGSIZE / sizeof *p; i++)
+		h = (h ^ p[i]) * 0x9e3779b97f4a7c15ULL;
+	return h;
+}
+
+/* Returns true if FRAME may be merged: it is in use by anonymous pages
+ * only, all still mapped, and not pinned.  FRAME_LOCK must be held. */
+static bool
+frame_mergeable (struct frame *frame) {
+	return frame != NULL && !frame->pinned && frame_mapped (frame)
+		&& frame_all_anon (frame);
+}
+
+/* Makes the pages that map FRAME read-only, or, if RW is true, gives
+ * back write access to its page if it is the only one and is
+ * writable. */
+static void
+frame_protect (struct frame *frame, bool rw) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		if (!rw || (frame->page_cnt == 1 && page->writable))
+			pml4_protect_range (page->owner->pml4, page->va, 1, rw);
+	}
+}
+
+/* Merges FRAME into INTO, if their contents are the same, and frees
+ * FRAME.  Returns true if they were merged. */
+static bool
+merge_frame (struct frame *frame, struct frame *into) {
+	bool same;
+
+	/* Nobody may write either frame while they are compared, nor move
+	 * them. */
+	frame_set_pinned (frame, true);
+	frame_protect (frame, false);
+	if (into != &zero_frame) {
+		frame_set_pinned (into, true);
+		frame_protect (into, false);
+	}
+
+	same = !memcmp (frame->kva, into->kva, PGSIZE);
+	if (same) {
+		while (!list_empty (&frame->pages)) {
+			struct page *page = list_entry (list_front (&frame->pages),
+					struct page, frame_elem);
+
+			pml4_remap_page (page->owner->pml4, page->va, into->kva);
+			frame_unlink (page);
+			frame_link (into, page);
+		}
+		frame_free (frame);
+	} else
+		frame_protect (frame, true);
+
+	if (into != &zero_frame) {
+		if (!same)
+			frame_protect (into, true);
+		frame_set_pinned (into, false);
+	}
+	if (!same)
+		frame_set_pinned (frame, false);
+	return same;
+}
+
+/* Looks up the frame at index IDX, whose contents hash to CHECKSUM, in
+ * MERGE_HASHES, and merges it into an earlier frame with the same
+ * contents.  Otherwise adds it, if there is room. */
+static void
+merge_lookup (size_t idx, uint64_t checksum) {
+	struct frame *frame = frame_table[idx];
+	size_t mask = merge_hash_cnt - 1;
+	size_t i;
+
+	if (checksum == zero_checksum && merge_frame (frame, &zero_frame)) {
+		merge_cnt++;
+		merge_zero_cnt++;
+		return;
+	}
+
+	for (i = checksum & mask; merge_hashes[i].idx != 0; i = (i + 1) & mask) {
+		struct merge_entry *m = &merge_hashes[i];
+		struct frame *into;
+
+		if (m->checksum != checksum)
+			continue;
+		into = frame_table[m->idx - 1];
+		if (into == NULL || into == frame || !into->checksummed
+				|| into->checksum != checksum) {
+			/* The frame went away or changed.  Take its place. */
+			m->idx = idx + 1;
+			return;
+		}
+		lock_acquire (&frame_lock);
+		if (!frame_mergeable (into)) {
+			lock_release (&frame_lock);
+			return;
+		}
+		lock_release (&frame_lock);
+		if (merge_frame (frame, into))
+			merge_cnt++;
+		return;
+	}
+
+	/* Keep the table at most half full. */
+	if (merge_hash_used < merge_hash_cnt / 2) {
+		merge_hashes[i].checksum = checksum;
+		merge_hashes[i].idx = idx + 1;
+		merge_hash_used++;
+	}
+}
+
+/* Scans the frame at index IDX for merging. */
+static void
+merge_scan (size_t idx) {
+	struct frame *frame;
+	uint64_t checksum;
+
+	lock_acquire (&frame_lock);
+	frame = frame_table[idx];
+	if (!frame_mergeable (frame)) {
+		lock_release (&frame_lock);
+		return;
+	}
+	lock_release (&frame_lock);
+
+	merge_scan_cnt++;
+	checksum = page_checksum (frame->kva);
+	if (!frame->checksummed || frame->checksum != checksum) {
+		frame->checksum = checksum;
+		frame->checksummed = true;
+		merge_volatile_cnt++;
+		return;
+	}
+	merge_lookup (idx, checksum);
+}
+
+/* Merges identical anonymous frames in the background.  It only runs
+ * when no other thread is ready, and stops in the middle of a pass as
+ * soon as one is. */
+static void
+merge_daemon (void *aux UNUSED) {
+	merge_hash_cnt = 1;
+	while (merge_hash_cnt < frame_cnt * 2)
+		merge_hash_cnt *= 2;
+	merge_hashes = calloc (merge_hash_cnt, sizeof *merge_hashes);
+	if (merge_hashes == NULL)
+		return;
+	zero_checksum = page_checksum (zero_frame.kva);
+
+	for (;;) {
+		size_t i;
+
+		timer_sleep (merge_interval > 0 ? merge_interval : 1);
+		if (merge_pages_per_pass == 0)
+			continue;
+
+		lock_acquire (&vm_lock);
+		merge_pass_cnt++;
+		for (i = 0; i < merge_pages_per_pass; i++) {
+			if (threads_ready () > 0) {
+				merge_pause_cnt++;
+				break;
+			}
+			merge_scan (merge_cursor);
+			if (++merge_cursor == frame_cnt) {
+				merge_cursor = 0;
+				memset (merge_hashes, 0, merge_hash_cnt * sizeof *merge_hashes);
+				merge_hash_used = 0;
+			}
+		}
+		lock_release (&vm_lock);
+	}
+}
+
+/* Prints the counts and latencies of page faults by class. */
+static void
+vm_print_fault_stats (void) {
+	size_t i, j;
+
+	for (i = 0; i < FAULT_CLASS_CNT; i++) {
+		const struct fault_class_stat *fs = &fault_stats[i];
+
+		if (fs->cnt == 0)
+			continue;
+		printf ("Faults: %-7s %llu, %llu cycles avg, %llu max, histogram",
+				fault_class_names[i], fs->cnt, fs->cycles / fs->cnt,
+				fs->max_cycles);
+		for (j = 0; j < FAULT_HIST_CNT; j++)
+			printf (" %llu", fs->hist[j]);
+		printf ("\n");
+	}
+}
+
+/* Prints virtual memory statistics. */
+void
+vm_print_stats (void) {
+	palloc_print_stats ();
+	printf ("Zero page: %zu pages mapped, %llu read faults, %llu written\n",
+			zero_frame.page_cnt, zero_map_cnt, zero_write_cnt);
+	printf ("Text cache: %zu frames, %llu faults shared a frame, "
+			"%llu read the file, %llu frames evicted\n",
+			hash_size (&text_cache), text_share_cnt, text_read_cnt,
+			evict_text_cnt);
+	printf ("Text cache: %llu data pages copied on write, "
+			"%llu read privately\n", text_copy_cnt, text_private_cnt);
+	printf ("Fault-around: %zu-page window, %llu faults, %llu faulted around, "
+			"%llu pages mapped, %llu faults avoided\n",
+			fault_around_pages, fault_cnt, around_fault_cnt, around_cnt,
+			around_used_cnt);
+	printf ("Swap readahead: %llu reads, %llu pages read ahead, "
+			"%llu hit, %llu dropped unused\n",
+			ra_read_cnt, ra_page_cnt, ra_hit_cnt, ra_miss_cnt);
+	vm_print_fault_stats ();
+	printf ("Madvise: %llu pages aged behind sequential faults, "
+			"%llu read in early, %llu frames dropped, %llu pages populated\n",
+			behind_cnt, willneed_cnt, dontneed_cnt, populate_cnt);
+	printf ("Writeback: %llu pages in %llu transfers, %llu msync calls, "
+			"kflushd woken %llu times\n",
+			wb_page_cnt, wb_run_cnt, msync_cnt, flush_run_cnt);
+	printf ("THP: %zu huge pages in use, %llu of %llu faults in eligible "
+			"blocks mapped one (%llu%%), %llu split, %llu freed whole\n",
+			thp_cnt, thp_alloc_cnt, thp_fault_cnt,
+			thp_fault_cnt > 0 ? thp_alloc_cnt * 100 / thp_fault_cnt : 0,
+			thp_split_cnt, thp_free_cnt);
+	printf ("COW: %llu pages shared by fork (%llu swapped out), "
+			"%llu copied on write, %llu written by their last sharer\n",
+			cow_share_cnt, cow_swap_cnt, cow_copy_cnt, cow_reuse_cnt);
+	printf ("Merging: %llu frames merged (%llu into the zero page), "
+			"%llu frames scanned (%llu changing), %llu passes (%llu paused)\n",
+			merge_cnt, merge_zero_cnt, merge_scan_cnt, merge_volatile_cnt,
+			merge_pass_cnt, merge_pause_cnt);
+	printf ("PFF: %zu of %zu frames under quota, %zu processes over, "
+			"%llu raises, %llu cuts, %llu victims over quota\n",
+			quota_total, frame_cnt, over_quota_cnt, quota_grow_cnt,
+			quota_shrink_cnt, over_victim_cnt);
+	printf ("Reclaim: %llu direct (%llu frames), %llu in background "
+			"(%llu frames, %llu pages cleaned), "
+			"watermarks %zu/%zu free pages\n",
+			direct_reclaim_cnt, direct_frame_cnt, kswapd_run_cnt,
+			kswapd_frame_cnt, kswapd_clean_cnt, kswapd_low, kswapd_high);
+	printf ("Eviction: %llu frames evicted (%llu clean), "
+			"%llu frames scanned (%llu avg, %llu max)\n",
+			evict_cnt, evict_clean_cnt, scan_cnt,
+			evict_cnt > 0 ? scan_cnt / evict_cnt : 0, scan_max);
+	anon_print_stats ();
+}
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -47,14 +753,37 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable,
 	ASSERT (VM_TYPE(type) != VM_UNINIT)
 
 	struct supplemental_page_table *spt = &thread_current ()->spt;
+	bool (*initializer) (struct page *, enum vm_type, void *);
+	struct page *page;
 
 	/* Check wheter the upage is already occupied or not. */
 	if (spt_find_page (spt, upage) == NULL) {
-		/* TODO: Create the page, fetch the initialier according to the VM type,
-		 * TODO: and then create "uninit" page struct by calling uninit_new. You
-		 * TODO: should modify the field after calling the uninit_new. */
+		switch (VM_TYPE (type)) {
+			case VM_ANON:
+				initializer = anon_initializer;
+				break;
+			case VM_FILE:
+				initializer = file_backed_initializer;
+				break;
+			default:
+				goto err;
+		}
 
-		/* TODO: Insert the page into the spt. */
+		page = malloc (sizeof *page);
+		if (page == NULL)
+			goto err;
+		uninit_new (page, upage, init, type, aux, initializer);
+		page->owner = thread_current ();
+		page->writable = writable;
+		page->around = false;
+		page->readahead = false;
+		page->advice = MADV_NORMAL;
+
+		if (!spt_insert_page (spt, page)) {
+			free (page);
+			goto err;
+		}
+		return true;
 	}
 err:
 	return false;
@@ -62,129 +791,2068 @@ err:
 
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
-spt_find_page (struct supplemental_page_table *spt UNUSED, void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function. */
-
-	return page;
+spt_find_page (struct supplemental_page_table *spt, void *va) {
+	if (!is_user_vaddr (va))
+		return NULL;
+	return radix_lookup (&spt->pages, pg_no (va));
 }
 
 /* Insert PAGE into spt with validation. */
 bool
-spt_insert_page (struct supplemental_page_table *spt UNUSED,
-		struct page *page UNUSED) {
-	int succ = false;
-	/* TODO: Fill this function. */
-
-	return succ;
+spt_insert_page (struct supplemental_page_table *spt, struct page *page) {
+	return radix_insert (&spt->pages, pg_no (page->va), page);
 }
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+	radix_remove (&spt->pages, pg_no (page->va));
+	vm_dealloc_page (page);
+}
+
+/* Destroys PAGE, once it is out of its spt. */
+static void
+page_destructor (uint64_t key UNUSED, void *page, void *aux UNUSED) {
 	vm_dealloc_page (page);
+}
+
+/* Removes the pages in [START, END), which must be page-aligned, from
+ * SPT and destroys them.  Only the parts of the table that hold pages
+ * are visited. */
+static void
+spt_remove_range (struct supplemental_page_table *spt, void *start,
+		void *end) {
+	radix_remove_range (&spt->pages, pg_no (start), pg_no (end),
+			page_destructor, NULL);
+}
+
+/* Adds to the current process the page at UPAGE of V, one of its VMAs,
+ * that has no page yet.  In a file mapping, it is a file-backed page
+ * that reads its part of the file, zero past the end; anywhere else,
+ * the zero-filled anonymous page that it stands for.  The page takes
+ * the access pattern advice of V. */
+static bool
+vm_alloc_vma_page (struct vma *v, void *upage) {
+	struct file_page *aux;
+	off_t ofs, length;
+
+	if (!(v->type & VM_MMAP) || v->file == NULL) {
+		if (!vm_alloc_page (VM_ANON | (v->type & VM_STACK), upage,
+					v->writable))
+			return false;
+		goto done;
+	}
+
+	aux = malloc (sizeof *aux);
+	if (aux == NULL)
+		return false;
+	ofs = v->ofs + ((uint8_t *) upage - v->start);
+	length = file_length (v->file);
+	aux->file = v->file;
+	aux->ofs = ofs;
+	aux->read_bytes = ofs >= length ? 0
+		: length - ofs < PGSIZE ? (size_t) (length - ofs) : PGSIZE;
+	if (!vm_alloc_page_with_initializer (VM_FILE, upage, v->writable, NULL,
+				aux)) {
+		free (aux);
+		return false;
+	}
+done:
+	spt_find_page (&thread_current ()->spt, upage)->advice = v->advice;
+	return true;
+}
+
+/* Returns true if PAGE can be evicted without writing it back, because
+ * its backing store already holds its contents. */
+static bool
+page_is_clean (struct page *page) {
+	if (pml4_is_dirty (page->owner->pml4, page->va))
+		return false;
+	return page_get_type (page) != VM_ANON
+		|| page->anon.slot != SWAP_SLOT_NONE;
+}
+
+/* Returns true if FRAME can be evicted without writing it back: all its
+ * pages are clean, and, if it is shared by anonymous pages, they all
+ * refer to the same swap slot. */
+static bool
+frame_is_clean (struct frame *frame) {
+	struct page *first = frame_first_page (frame);
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		if (!page_is_clean (page) || (page_get_type (page) == VM_ANON
+					&& page->anon.slot != first->anon.slot))
+			return false;
+	}
 	return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Shared anonymous frames.  A frame that several anonymous pages map,
+ * after fork or same-page merging, is swapped out once, through its
+ * first page, and the other pages then take a reference to the slot
+ * that it went to. */
+
+/* Unmaps the pages of anonymous FRAME other than the first, before it
+ * is swapped out through the first page.  A page that has been written
+ * gives up its slot.  Unless all the pages still refer to the first
+ * page's slot, that slot does not hold the frame's contents for all of
+ * them, and the first page gives it up too, so that the frame is
+ * written again. */
+static void
+share_unmap (struct frame *frame) {
+	struct page *first = frame_first_page (frame);
+	bool stale = false;
+	struct list_elem *e;
+
+	for (e = list_next (list_begin (&frame->pages));
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		if (vm_unmap_page (page))
+			anon_drop_slot (page);
+		if (page->anon.slot != first->anon.slot)
+			stale = true;
+	}
+	if (stale)
+		anon_drop_slot (first);
+}
+
+/* Gives the pages of FRAME other than the first the slot that the
+ * first page was swapped out to. */
+static void
+share_slot (struct frame *frame) {
+	struct page *first = frame_first_page (frame);
+	struct list_elem *e;
+
+	for (e = list_next (list_begin (&frame->pages));
+			e != list_end (&frame->pages); e = list_next (e))
+		anon_share_slot (list_entry (e, struct page, frame_elem), first);
+}
+
+/* Maps the pages of FRAME other than the first again, read-only, after
+ * the frame could not be swapped out. */
+static void
+share_remap (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_next (list_begin (&frame->pages));
+			e != list_end (&frame->pages); e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		pml4_set_page (page->owner->pml4, page->va, frame->kva, false);
+	}
+}
+
+/* Returns true if any page that maps FRAME has been accessed since its
+ * accessed bit was last cleared.  If CLEAR is true, clears the bits.
+ * FRAME_LOCK must be held. */
+static bool
+frame_accessed (struct frame *frame, bool clear) {
+	struct list_elem *e;
+	bool accessed = false;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e)) {
+		struct page *page = list_entry (e, struct page, frame_elem);
+
+		check_around (page);
+		if (pml4_is_accessed (page->owner->pml4, page->va)) {
+			accessed = true;
+			if (clear)
+				pml4_set_accessed (page->owner->pml4, page->va, false);
+		}
+	}
+	return accessed;
+}
+
+/* Get the struct frame, that will be evicted.
+ *
+ * This is the clock algorithm, extended to prefer clean pages.  The
+ * hand sweeps the frame table in rounds of two sweeps.  The first looks
+ * for a page that is neither recently accessed nor dirty and changes
+ * nothing.  The second settles for a dirty page, and clears the
+ * accessed bit of every page that it passes over, giving it a second
+ * chance.  So the second round always finds a victim unless every frame
+ * is pinned or shared with a file-backed page.  A shared frame is
+ * recently accessed if any of its pages is.  It is evicted as a whole
+ * if it belongs to the text cache, whose frames are clean, or if only
+ * anonymous pages map it; see share_unmap().  If some process is over
+ * its frame quota, a first
+ * round of two sweeps of the second kind looks only at its pages.  The
+ * victim is returned pinned.
+ *
+ * A huge page is looked at once per sweep, as a whole.  If it has not
+ * been accessed since the last sweep of the second kind, the search
+ * stops without a victim and stores it in *SPLIT, for the caller to
+ * split it and try again. */
 static struct frame *
-vm_get_victim (void) {
+vm_get_victim (struct huge_page **split) {
 	struct frame *victim = NULL;
-	 /* TODO: The policy for eviction is up to you. */
+	size_t scanned = 0;
+	int pass;
+
+	*split = NULL;
+	lock_acquire (&frame_lock);
+	for (pass = over_quota_cnt > 0 ? -2 : 0;
+			pass < 4 && victim == NULL && *split == NULL; pass++) {
+		bool want_clean = pass >= 0 && pass % 2 == 0;
+		bool over_only = pass < 0;
+		size_t i;
+
+		for (i = 0; i < frame_cnt && victim == NULL && *split == NULL; i++) {
+			struct frame *frame = frame_table[clock_hand];
+
+			clock_hand = (clock_hand + 1) % frame_cnt;
+			if (frame != NULL && frame->huge != NULL) {
+				struct huge_page *h = frame->huge;
+				size_t end = frame_slot (frame->kva) - frame_table
+					+ HUGE_PAGE_CNT;
 
+				/* Skip the rest of its frames. */
+				i += (end - clock_hand) % frame_cnt;
+				clock_hand = end % frame_cnt;
+				if (over_only && !h->owner->over_quota)
+					continue;
+				scanned++;
+				if (!pml4_is_accessed (h->owner->pml4, h->va)) {
+					/* Its frames come up next once it is split. */
+					*split = h;
+					clock_hand = end - HUGE_PAGE_CNT;
+				} else if (!want_clean)
+					pml4_set_accessed (h->owner->pml4, h->va, false);
+				continue;
+			}
+			if (frame == NULL || frame->pinned || !frame_mapped (frame)
+					|| (frame->page_cnt != 1 && frame->text_inode == NULL
+						&& !frame_all_anon (frame)))
+				continue;
+			if (over_only && (frame->page_cnt != 1
+						|| !frame_page (frame)->owner->over_quota))
+				continue;
+			scanned++;
+
+			if (frame_accessed (frame, !want_clean))
+				continue;
+			if (!want_clean || frame->text_inode != NULL
+					|| frame_is_clean (frame))
+				victim = frame;
+		}
+		if (victim != NULL && over_only)
+			over_victim_cnt++;
+	}
+	if (victim != NULL)
+		victim->pinned = true;
+
+	scan_cnt += scanned;
+	if (scanned > scan_max)
+		scan_max = scanned;
+	lock_release (&frame_lock);
 	return victim;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+ * Return NULL on error.
+ *
+ * Up to EVICT_BATCH victims are evicted at once, so that anonymous
+ * ones can be written to swap together.  The frames beyond the first
+ * go back to the user pool, and the allocations that follow do not
+ * have to evict. */
 static struct frame *
 vm_evict_frame (void) {
-	struct frame *victim UNUSED = vm_get_victim ();
-	/* TODO: swap out the victim and return the evicted frame. */
+	struct frame *victims[EVICT_BATCH];
+	struct page *anon_pages[EVICT_BATCH];
+	bool clean[EVICT_BATCH], evicted[EVICT_BATCH];
+	struct frame *frame = NULL;
+	size_t victim_cnt, anon_cnt = 0, clean_cnt = 0, evicted_cnt = 0, i;
 
-	return NULL;
+	for (victim_cnt = 0; victim_cnt < EVICT_BATCH; ) {
+		struct huge_page *split;
+		struct frame *victim = vm_get_victim (&split);
+
+		if (victim != NULL)
+			victims[victim_cnt++] = victim;
+		else if (split == NULL || !huge_split (split))
+			break;
+	}
+
+	/* The victims are pinned, so they stay put while they are written
+	 * out. */
+	for (i = 0; i < victim_cnt; i++) {
+		struct page *page;
+
+		if (victims[i]->text_inode != NULL) {
+			clean[i] = evicted[i] = text_swap_out (victims[i]);
+			continue;
+		}
+		page = frame_first_page (victims[i]);
+		clean[i] = frame_is_clean (victims[i]);
+		evicted[i] = false;
+		if (page_get_type (page) == VM_ANON) {
+			share_unmap (victims[i]);
+			anon_pages[anon_cnt++] = page;
+		} else
+			evicted[i] = swap_out (page);
+	}
+	if (anon_cnt > 0) {
+		/* If swap is too full for the whole batch, the clean pages
+		 * can still go one by one. */
+		bool batched = anon_swap_out_batch (anon_pages, anon_cnt);
+
+		for (i = 0; i < victim_cnt; i++)
+			if (victims[i]->text_inode == NULL
+					&& page_get_type (frame_first_page (victims[i])) == VM_ANON)
+				evicted[i] = batched
+					|| swap_out (frame_first_page (victims[i]));
+	}
+
+	for (i = 0; i < victim_cnt; i++) {
+		struct frame *victim = victims[i];
+
+		if (!evicted[i]) {
+			if (victim->text_inode == NULL)
+				share_remap (victim);
+			frame_set_pinned (victim, false);
+			continue;
+		}
+		if (victim->text_inode != NULL) {
+			lock_acquire (&frame_lock);
+			text_uncache (victim);
+			evict_text_cnt++;
+			lock_release (&frame_lock);
+		} else
+			share_slot (victim);
+		while (!list_empty (&victim->pages)) {
+			struct page *page = list_entry (list_front (&victim->pages),
+					struct page, frame_elem);
+
+			page->owner->evicted_cnt++;
+			frame_unlink (page);
+		}
+		evicted_cnt++;
+		if (clean[i])
+			clean_cnt++;
+		if (frame == NULL)
+			frame = victim;
+		else
+			frame_free (victim);
+	}
+
+	lock_acquire (&frame_lock);
+	evict_cnt += evicted_cnt;
+	evict_clean_cnt += clean_cnt;
+	lock_release (&frame_lock);
+	return frame;
+}
+
+/* Removes PAGE from its owner's page table, so that the owner faults on
+ * its next access, and returns true if the owner has written to it
+ * since it was mapped.  Called by swap_out() before the page's contents
+ * are saved. */
+bool
+vm_unmap_page (struct page *page) {
+	uint64_t *pml4 = page->owner->pml4;
+	enum intr_level old_level;
+	bool dirty;
+
+	/* The owner could set the dirty bit between the test and the
+	 * unmapping if it ran in between. */
+	old_level = intr_disable ();
+	dirty = pml4_is_dirty (pml4, page->va);
+	pml4_clear_page (pml4, page->va);
+	intr_set_level (old_level);
+	return dirty;
+}
+
+/* Takes back the swap slots that anonymous pages in memory kept from
+ * their last swap-out, for when the swap disk is full.  A page only
+ * needs its slot to be evicted again without being written.  The pages
+ * of pinned frames, which include those being evicted, keep theirs.
+ * Returns the number of pages that gave up a slot.  The caller must
+ * hold VM_LOCK. */
+size_t
+vm_free_swap_slots (void) {
+	size_t cnt = 0, i;
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < frame_cnt; i++) {
+		struct frame *frame = frame_table[i];
+		struct list_elem *e;
+
+		if (frame == NULL || frame->pinned)
+			continue;
+		for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+				e = list_next (e)) {
+			struct page *page = list_entry (e, struct page, frame_elem);
+
+			if (VM_TYPE (page->operations->type) == VM_ANON
+					&& page->anon.slot != SWAP_SLOT_NONE) {
+				anon_drop_slot (page);
+				cnt++;
+			}
+		}
+	}
+	lock_release (&frame_lock);
+	return cnt;
+}
+
+/* Returns the number of frames evicted so far. */
+static uint64_t
+evicted_frames (void) {
+	uint64_t cnt;
+
+	lock_acquire (&frame_lock);
+	cnt = evict_cnt;
+	lock_release (&frame_lock);
+	return cnt;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it. Returns NULL only if the user pool is exhausted and no
+ * frame can be evicted.  The frame is returned pinned.  The caller must
+ * hold VM_LOCK. */
 static struct frame *
 vm_get_frame (void) {
-	struct frame *frame = NULL;
-	/* TODO: Fill this function. */
+	struct frame *frame = frame_alloc ();
+	uint64_t before;
 
-	ASSERT (frame != NULL);
-	ASSERT (frame->page == NULL);
+	if (frame != NULL)
+		return frame;
+	before = evicted_frames ();
+	frame = vm_evict_frame ();
+	direct_reclaim_cnt++;
+	direct_frame_cnt += evicted_frames () - before;
 	return frame;
 }
 
-/* Growing the stack. */
+/* Wakes kswapd if the user pool is running low.  The caller must hold
+ * VM_LOCK. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+kswapd_check (void) {
+	if (!kswapd_woken && palloc_user_free () < kswapd_low) {
+		kswapd_woken = true;
+		sema_up (&kswapd_sema);
+	}
 }
 
-/* Handle the fault on write_protected page */
-static bool
-vm_handle_wp (struct page *page UNUSED) {
-}
+/* Background reclaim thread.  It takes VM_LOCK for one batch of
+ * evictions at a time, so faults can go on in between. */
+static void
+kswapd (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&kswapd_sema);
 
-/* Return true on success */
-bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED,
-		bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-	struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
-	struct page *page = NULL;
-	/* TODO: Validate the fault */
-	/* TODO: Your code goes here */
+		lock_acquire (&vm_lock);
+		kswapd_run_cnt++;
+		kswapd_clean ();
+		while (palloc_user_free () < kswapd_high) {
+			uint64_t before = evicted_frames ();
+			struct frame *frame = vm_evict_frame ();
 
-	return vm_do_claim_page (page);
+			if (frame == NULL)
+				break;
+			frame_free (frame);
+			kswapd_frame_cnt += evicted_frames () - before;
+			lock_release (&vm_lock);
+			thread_yield ();
+			lock_acquire (&vm_lock);
+		}
+		kswapd_woken = false;
+		lock_release (&vm_lock);
+	}
 }
 
-/* Free the page.
- * DO NOT MODIFY THIS FUNCTION. */
-void
-vm_dealloc_page (struct page *page) {
-	destroy (page);
-	free (page);
-}
+/* Allocates a frame from free memory, without evicting, and returns it
+ * pinned.  Returns NULL if no page is free.  The caller must hold
+ * VM_LOCK. */
+static struct frame *
+frame_alloc (void) {
+	struct frame *frame;
+	void *kva;
 
-/* Claim the page that allocate on VA. */
-bool
-vm_claim_page (void *va UNUSED) {
-	struct page *page = NULL;
-	/* TODO: Fill this function */
+	kva = palloc_get_page (PAL_USER | PAL_TAG (MEM_VM));
+	kswapd_check ();
+	if (kva == NULL)
+		return NULL;
 
-	return vm_do_claim_page (page);
-}
+	frame = malloc (sizeof *frame);
+	if (frame == NULL) {
+		palloc_free_page (kva);
+		return NULL;
+	}
+	frame->kva = kva;
+	list_init (&frame->pages);
+	frame->page_cnt = 0;
+	frame->pinned = true;
+	frame->checksummed = false;
+	frame->text_inode = NULL;
+	frame->huge = NULL;
 
-/* Claim the PAGE and set up the mmu. */
-static bool
-vm_do_claim_page (struct page *page) {
-	struct frame *frame = vm_get_frame ();
+	lock_acquire (&frame_lock);
+	*frame_slot (kva) = frame;
+	lock_release (&frame_lock);
 
-	/* Set links */
-	frame->page = page;
-	page->frame = frame;
+	ASSERT (frame->page_cnt == 0);
+	return frame;
+}
+
+/* Removes FRAME from the text cache, if it is there.  FRAME_LOCK must
+ * be held. */
+static void
+text_uncache (struct frame *frame) {
+	if (frame->text_inode != NULL) {
+		hash_delete (&text_cache, &frame->text_elem);
+		frame->text_inode = NULL;
+	}
+}
 
-	/* TODO: Insert page table entry to map page's VA to frame's PA. */
+/* Removes FRAME from the frame table and frees it. */
+static void
+frame_free (struct frame *frame) {
+	lock_acquire (&frame_lock);
+	*frame_slot (frame->kva) = NULL;
+	text_uncache (frame);
+	lock_release (&frame_lock);
 
-	return swap_in (page, frame->kva);
+	palloc_free_page (frame->kva);
+	free (frame);
 }
 
-/* Initialize new supplemental page table */
+/* Unmaps PAGE from its owner's page table and releases its frame, if
+ * it has one.  The frame is freed once no page maps it. */
 void
-supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
+vm_free_frame (struct page *page) {
+	struct frame *frame = page->frame;
+
+	if (frame == NULL)
+		return;
+	check_around (page);
+	if (page->owner->pml4 != NULL)
+		pml4_clear_page (page->owner->pml4, page->va);
+	frame_unlink (page);
+	if (frame->page_cnt == 0 && frame != &zero_frame)
+		frame_free (frame);
 }
 
-/* Copy supplemental page table from src to dst */
-bool
-supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED,
-		struct supplemental_page_table *src UNUSED) {
+/* Returns true if PAGE, which must have a frame, belongs to a writable
+ * file mapping and has been written since it was last written back. */
+static bool
+page_needs_writeback (struct page *page) {
+	return page->writable && VM_TYPE (page->operations->type) == VM_FILE
+		&& page->file.read_bytes > 0 && page->owner->pml4 != NULL
+		&& pml4_is_dirty (page->owner->pml4, page->va);
 }
 
-/* Free the resource hold by the supplemental page table */
-void
-supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
-	/* TODO: Destroy all the supplemental_page_table hold by thread and
-	 * TODO: writeback all the modified contents to the storage. */
+/* Returns true if file-backed PAGE comes right after PREV in the same
+ * file. */
+static bool
+page_follows (struct page *prev, struct page *page) {
+	return file_get_inode (page->file.file) == file_get_inode (prev->file.file)
+		&& page->file.ofs == prev->file.ofs + PGSIZE
+		&& prev->file.read_bytes == PGSIZE;
+}
+
+/* Returns true if file-backed page A comes before page B in file
+ * order. */
+static bool
+page_file_less (struct page *a, struct page *b) {
+	struct inode *ai = file_get_inode (a->file.file);
+	struct inode *bi = file_get_inode (b->file.file);
+
+	return ai != bi ? ai < bi : a->file.ofs < b->file.ofs;
+}
+
+/* Writes back the CNT pages in PAGES, at most WB_BATCH, whose frames
+ * must be pinned, and unpins them.  Sorted by file and offset, so that
+ * the runs of pages that are adjacent in a file each go to disk in one
+ * transfer.  The caller must hold VM_LOCK. */
+static void
+writeback_pages (struct page *pages[], size_t cnt) {
+	void *kvas[WB_BATCH];
+	size_t i, j;
+
+	ASSERT (cnt <= WB_BATCH);
+
+	for (i = 1; i < cnt; i++) {
+		struct page *page = pages[i];
+
+		for (j = i; j > 0 && page_file_less (page, pages[j - 1]); j--)
+			pages[j] = pages[j - 1];
+		pages[j] = page;
+	}
+
+	for (i = 0; i < cnt; i = j) {
+		struct page *first = pages[i];
+		off_t size = 0;
+
+		for (j = i; j < cnt && (j == i || page_follows (pages[j - 1], pages[j]));
+				j++) {
+			/* Writes from here on dirty the page again. */
+			pml4_set_dirty (pages[j]->owner->pml4, pages[j]->va, false);
+			kvas[j - i] = pages[j]->frame->kva;
+			size += pages[j]->file.read_bytes;
+		}
+		file_write_pages_at (first->file.file, kvas, j - i, size,
+				first->file.ofs);
+		wb_page_cnt += j - i;
+		wb_run_cnt++;
+	}
+	for (i = 0; i < cnt; i++)
+		frame_set_pinned (pages[i]->frame, false);
+}
+
+/* Dirty pages collected by collect_dirty(). */
+struct wb_batch {
+	struct page *pages[WB_BATCH];
+	size_t cnt;
+};
+
+/* Adds PAGE, from an spt, to the batch in BATCH_ if it needs to be
+ * written back, and writes back the batch once it is full. */
+static bool
+collect_dirty (uint64_t key UNUSED, void *page_, void *batch_) {
+	struct page *page = page_;
+	struct wb_batch *batch = batch_;
+
+	if (page->frame == NULL || !page_needs_writeback (page))
+		return true;
+	frame_set_pinned (page->frame, true);
+	batch->pages[batch->cnt++] = page;
+	if (batch->cnt == WB_BATCH) {
+		writeback_pages (batch->pages, batch->cnt);
+		batch->cnt = 0;
+	}
+	return true;
+}
+
+/* Writes back the dirty pages of file mappings in [START, END) of SPT.
+ * Only the pages in SPT are visited.  The caller must hold VM_LOCK. */
+static void
+spt_writeback (struct supplemental_page_table *spt, void *start, void *end) {
+	struct wb_batch batch;
+
+	batch.cnt = 0;
+	radix_walk (&spt->pages, pg_no (start), pg_no (end), collect_dirty,
+			&batch);
+	if (batch.cnt > 0)
+		writeback_pages (batch.pages, batch.cnt);
+}
+
+/* Looks at up to *LEFT frames of the frame table, starting at *IDX and
+ * wrapping around, and pins the pages of up to WB_BATCH of them that
+ * need to be written back, storing them in PAGES.  Advances *IDX and
+ * reduces *LEFT past the frames looked at, and returns the number of
+ * pages stored.  The caller must hold VM_LOCK. */
+static size_t
+collect_frame_dirty (struct page *pages[], size_t *idx, size_t *left) {
+	size_t cnt = 0;
+
+	lock_acquire (&frame_lock);
+	for (; *left > 0 && cnt < WB_BATCH; --*left) {
+		struct frame *frame = frame_table[*idx];
+
+		*idx = (*idx + 1) % frame_cnt;
+		if (frame != NULL && !frame->pinned && frame->page_cnt == 1
+				&& page_needs_writeback (frame_page (frame))) {
+			frame->pinned = true;
+			pages[cnt++] = frame_page (frame);
+		}
+	}
+	lock_release (&frame_lock);
+	return cnt;
+}
+
+/* Writes back the dirty pages of all file mappings, in batches taken
+ * from the frame table, when woken by MS_ASYNC.  VM_LOCK is released
+ * between batches. */
+static void
+flush_daemon (void *aux UNUSED) {
+	for (;;) {
+		struct page *pages[WB_BATCH];
+		size_t idx = 0, left;
+
+		sema_down (&flush_sema);
+
+		lock_acquire (&vm_lock);
+		flush_woken = false;
+		flush_run_cnt++;
+		left = frame_cnt;
+		while (left > 0) {
+			writeback_pages (pages, collect_frame_dirty (pages, &idx, &left));
+			lock_release (&vm_lock);
+			thread_yield ();
+			lock_acquire (&vm_lock);
+		}
+		lock_release (&vm_lock);
+	}
+}
+
+/* Writes back the dirty pages of file mappings in the KSWAPD_HIGH
+ * frames that the clock hand reaches next, so that evicting them
+ * later needs no write.  The caller must hold VM_LOCK, which is
+ * released between batches. */
+static void
+kswapd_clean (void) {
+	struct page *pages[WB_BATCH];
+	size_t idx = clock_hand;
+	size_t left = kswapd_high < frame_cnt ? kswapd_high : frame_cnt;
+
+	while (left > 0) {
+		size_t cnt = collect_frame_dirty (pages, &idx, &left);
+
+		if (cnt == 0)
+			continue;
+		writeback_pages (pages, cnt);
+		kswapd_clean_cnt += cnt;
+		lock_release (&vm_lock);
+		thread_yield ();
+		lock_acquire (&vm_lock);
+	}
+}
+
+/* Returns the huge page of SPT that contains VA, or a null pointer. */
+static struct huge_page *
+huge_find (struct supplemental_page_table *spt, const void *va) {
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->huges); e != list_end (&spt->huges);
+			e = list_next (e)) {
+		struct huge_page *h = list_entry (e, struct huge_page, elem);
+
+		if ((const uint8_t *) va >= h->va
+				&& (const uint8_t *) va < h->va + HUGE_PAGE_SIZE)
+			return h;
+	}
+	return NULL;
+}
+
+/* Stops radix_walk() at the first page. */
+static bool
+stop_at_page (uint64_t key UNUSED, void *page UNUSED, void *aux UNUSED) {
+	return false;
+}
+
+/* Maps the 2 MB aligned block that contains ADDR, in V, one of the
+ * current process's VMAs, with a huge page, if V is writable
+ * zero-filled anonymous memory that covers the whole block, the block
+ * has no pages yet, and an aligned run of free frames is available
+ * without going below the reclaim watermark or over the process's frame
+ * quota.  Returns true if successful. */
+static bool
+vm_alloc_huge (struct vma *v, void *addr) {
+	struct thread *t = thread_current ();
+	struct supplemental_page_table *spt = &t->spt;
+	uint8_t *base = (uint8_t *) ((uint64_t) addr & ~(uint64_t) (HUGE_PAGE_SIZE - 1));
+	struct huge_page *h;
+	size_t i;
+
+	if (!thp_enabled || VM_TYPE (v->type) != VM_ANON || (v->type & VM_STACK)
+			|| !v->writable || base < v->start
+			|| base + HUGE_PAGE_SIZE > v->end
+			|| !radix_walk (&spt->pages, pg_no (base),
+				pg_no (base) + HUGE_PAGE_CNT, stop_at_page, NULL))
+		return false;
+	thp_fault_cnt++;
+	if (palloc_user_free () < kswapd_high + HUGE_PAGE_CNT
+			|| (t->frame_quota != 0
+				&& t->rss + HUGE_PAGE_CNT > t->frame_quota))
+		return false;
+
+	h = malloc (sizeof *h);
+	if (h == NULL)
+		return false;
+	h->frame.kva = palloc_get_aligned (PAL_USER | PAL_ZERO | PAL_TAG (MEM_VM),
+			HUGE_PAGE_CNT);
+	kswapd_check ();
+	if (h->frame.kva == NULL
+			|| !pml4_set_huge_page (t->pml4, base, h->frame.kva, true)) {
+		palloc_free_multiple (h->frame.kva, HUGE_PAGE_CNT);
+		free (h);
+		return false;
+	}
+	h->va = base;
+	h->owner = t;
+	h->writable = true;
+	list_init (&h->frame.pages);
+	h->frame.page_cnt = 0;
+	h->frame.pinned = true;
+	h->frame.checksummed = false;
+	h->frame.text_inode = NULL;
+	h->frame.huge = h;
+	list_push_back (&spt->huges, &h->elem);
+
+	lock_acquire (&frame_lock);
+	for (i = 0; i < HUGE_PAGE_CNT; i++)
+		*frame_slot ((uint8_t *) h->frame.kva + i * PGSIZE) = &h->frame;
+	t->rss += HUGE_PAGE_CNT;
+	quota_check (t);
+	lock_release (&frame_lock);
+	thp_cnt++;
+	thp_alloc_cnt++;
+	return true;
+}
+
+/* Unmaps huge page H and frees it. */
+static void
+huge_free (struct huge_page *h) {
+	size_t i;
+
+	if (h->owner->pml4 != NULL)
+		pml4_clear_huge_page (h->owner->pml4, h->va);
+	lock_acquire (&frame_lock);
+	for (i = 0; i < HUGE_PAGE_CNT; i++)
+		*frame_slot ((uint8_t *) h->frame.kva + i * PGSIZE) = NULL;
+	h->owner->rss -= HUGE_PAGE_CNT;
+	quota_check (h->owner);
+	lock_release (&frame_lock);
+
+	list_remove (&h->elem);
+	palloc_free_multiple (h->frame.kva, HUGE_PAGE_CNT);
+	free (h);
+	thp_cnt--;
+	thp_free_cnt++;
+}
+
+/* Frees a page made by huge_split() that was never linked to its
+ * frame, and the frame. */
+static void
+unsplit_page (uint64_t key UNUSED, void *page_, void *aux UNUSED) {
+	struct page *page = page_;
+
+	free (page->frame);
+	free (page);
+}
+
+/* Splits huge page H into HUGE_PAGE_CNT ordinary anonymous pages, each
+ * with a frame of its own in the run, so that they can be evicted,
+ * freed or shared one by one.  Returns false, leaving H alone, if
+ * memory is short.  The caller must hold VM_LOCK. */
+static bool
+huge_split (struct huge_page *h) {
+	struct thread *t = h->owner;
+	struct radix *pages = &t->spt.pages;
+	struct vma *v = vma_find (&t->spt.vmas, h->va);
+	uint64_t first = pg_no (h->va);
+	size_t i;
+
+	/* Make all the pages first, so that nothing changes on failure.
+	 * Until they are linked, each page's FRAME is its frame to be. */
+	for (i = 0; i < HUGE_PAGE_CNT; i++) {
+		struct page *page = malloc (sizeof *page);
+		struct frame *frame = malloc (sizeof *frame);
+
+		if (page == NULL || frame == NULL
+				|| !radix_insert (pages, first + i, page)) {
+			free (page);
+			free (frame);
+			goto fail;
+		}
+		uninit_new (page, h->va + i * PGSIZE, NULL, VM_ANON, NULL,
+				anon_initializer);
+		anon_init_page (page);
+		page->owner = t;
+		page->writable = h->writable;
+		page->around = false;
+		page->readahead = false;
+		/* Advice given for part of the huge page split its VMA. */
+		if (v != NULL && (uint8_t *) page->va >= v->end)
+			v = vma_find (&t->spt.vmas, page->va);
+		page->advice = v != NULL ? v->advice : MADV_NORMAL;
+		page->frame = frame;
+
+		frame->kva = (uint8_t *) h->frame.kva + i * PGSIZE;
+		list_init (&frame->pages);
+		frame->page_cnt = 0;
+		frame->pinned = false;
+		frame->checksummed = false;
+		frame->text_inode = NULL;
+		frame->huge = NULL;
+	}
+	if (!pml4_split_huge_page (t->pml4, h->va))
+		goto fail;
+
+	/* The process keeps the same number of frames. */
+	lock_acquire (&frame_lock);
+	for (i = 0; i < HUGE_PAGE_CNT; i++) {
+		struct page *page = radix_lookup (pages, first + i);
+		struct frame *frame = page->frame;
+
+		list_push_back (&frame->pages, &page->frame_elem);
+		frame->page_cnt = 1;
+		*frame_slot (frame->kva) = frame;
+	}
+	lock_release (&frame_lock);
+
+	list_remove (&h->elem);
+	free (h);
+	thp_cnt--;
+	thp_split_cnt++;
+	return true;
+
+fail:
+	radix_remove_range (pages, first, first + i, unsplit_page, NULL);
+	return false;
+}
+
+/* Gets the huge pages of SPT that overlap [START, END) out of the way
+ * of an operation on the ordinary pages of the range.  If FREE, the
+ * ones inside the range are freed, because the operation frees its
+ * pages; the others are split.  Returns false if one could not be
+ * split.  The caller must hold VM_LOCK. */
+static bool
+huge_prepare (struct supplemental_page_table *spt, void *start_, void *end_,
+		bool free) {
+	uint8_t *start = start_, *end = end_;
+	struct list_elem *e;
+
+	for (e = list_begin (&spt->huges); e != list_end (&spt->huges); ) {
+		struct huge_page *h = list_entry (e, struct huge_page, elem);
+
+		e = list_next (e);
+		if (h->va + HUGE_PAGE_SIZE <= start || h->va >= end)
+			continue;
+		if (free && h->va >= start && h->va + HUGE_PAGE_SIZE <= end)
+			huge_free (h);
+		else if (!huge_split (h))
+			return false;
+	}
+	return true;
+}
+
+/* Growing the stack. */
+static void
+vm_stack_growth (void *addr) {
+	void *upage = pg_round_down (addr);
+
+	if (vma_map (&thread_current ()->spt.vmas, upage,
+				(uint8_t *) upage + PGSIZE, VM_ANON | VM_STACK, NULL, 0, true)
+			&& !vm_alloc_page (VM_ANON | VM_STACK, upage, true))
+		vma_unmap (&thread_current ()->spt.vmas, upage,
+				(uint8_t *) upage + PGSIZE);
+}
+
+/* Handle the fault on write_protected page.  The page is writable but
+ * mapped read-only because fork left its frame shared, because it maps
+ * the zero frame, or because it is a page of a writable segment of the
+ * executable that maps a text cache frame.  It gets a private copy of
+ * the frame, unless it is the only page still mapping the frame, which
+ * it can then simply take over.  A text cache frame is always copied,
+ * and the page becomes anonymous. */
+static bool
+vm_handle_wp (struct page *page) {
+	struct frame *old = page->frame, *frame;
+	bool text;
+
+	if (old == NULL)
+		return false;
+	text = old->text_inode != NULL;
+	if (old == &zero_frame) {
+		frame = vm_get_frame ();
+		if (frame == NULL)
+			return false;
+		memset (frame->kva, 0, PGSIZE);
+		frame_unlink (page);
+		frame_link (frame, page);
+		pml4_set_page (page->owner->pml4, page->va, frame->kva, true);
+		frame_set_pinned (frame, false);
+		zero_write_cnt++;
+		return true;
+	}
+	if (old->page_cnt == 1 && !text) {
+		cow_reuse_cnt++;
+		return pml4_set_page (page->owner->pml4, page->va, old->kva, true);
+	}
+
+	/* Nobody can write the old frame, but it must not move while it is
+	 * copied. */
+	frame_set_pinned (old, true);
+	frame = vm_get_frame ();
+	if (frame != NULL) {
+		memcpy (frame->kva, old->kva, PGSIZE);
+		frame_unlink (page);
+		frame_link (frame, page);
+	}
+	frame_set_pinned (old, false);
+	if (frame == NULL)
+		return false;
+
+	pml4_set_page (page->owner->pml4, page->va, frame->kva, true);
+	frame_set_pinned (frame, false);
+	if (text) {
+		anon_init_page (page);
+		text_copy_cnt++;
+	} else
+		cow_copy_cnt++;
+	return true;
+}
+
+/* Returns true if PAGE has not been loaded yet and is zero-filled
+ * anonymous memory. */
+static bool
+is_zero_fill (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& VM_TYPE (page->uninit.type) == VM_ANON
+		&& page->uninit.init == NULL;
+}
+
+/* Maps PAGE, which must be zero-filled and untouched, to the zero
+ * frame. */
+static bool
+vm_map_zero (struct page *page) {
+	if (!pml4_set_page (page->owner->pml4, page->va, zero_frame.kva, false))
+		return false;
+	anon_init_page (page);
+	frame_link (&zero_frame, page);
+	zero_map_cnt++;
+	return true;
+}
+
+/* Returns a hash value for the text cache frame that E refers to. */
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct frame *f = hash_entry (e, struct frame, text_elem);
+	uint64_t key[3] = { (uint64_t) f->text_inode, f->text_ofs, f->text_bytes };
+
+	return hash_bytes (key, sizeof key);
+}
+
+/* Returns true if the text cache frame A precedes frame B. */
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_,
+		void *aux UNUSED) {
+	const struct frame *a = hash_entry (a_, struct frame, text_elem);
+	const struct frame *b = hash_entry (b_, struct frame, text_elem);
+
+	if (a->text_inode != b->text_inode)
+		return a->text_inode < b->text_inode;
+	if (a->text_ofs != b->text_ofs)
+		return a->text_ofs < b->text_ofs;
+	return a->text_bytes < b->text_bytes;
+}
+
+/* Returns where the contents of PAGE come from, if it is file-backed,
+ * or a null pointer. */
+static const struct file_page *
+file_info (struct page *page) {
+	if (VM_TYPE (page->operations->type) == VM_FILE)
+		return &page->file;
+	if (VM_TYPE (page->operations->type) == VM_UNINIT
+			&& VM_TYPE (page->uninit.type) == VM_FILE)
+		return page->uninit.aux;
+	return NULL;
+}
+
+/* Returns true if PAGE is backed by its owner's executable.  Only
+ * executables, which cannot be written while they run, are cached;
+ * pages of file mappings are not shared.  Such a page of a writable
+ * segment is private: it becomes anonymous at its first write. */
+static bool
+is_exec_page (struct page *page) {
+	const struct file_page *info = file_info (page);
+
+	return info != NULL && info->file == page->owner->running_file;
+}
+
+/* Returns where the contents of PAGE come from, if it is a page of its
+ * owner's executable that has no frame, or a null pointer. */
+static const struct file_page *
+text_info (struct page *page) {
+	if (page->frame != NULL || !is_exec_page (page))
+		return NULL;
+	return file_info (page);
+}
+
+/* Maps PAGE, a file-backed page of the executable, read-only to the text
+ * cache frame that holds its contents.  If there is none, reads them
+ * into a new frame, allocated by GET_FRAME, and adds it to the cache. */
+static bool
+vm_map_text (struct page *page, struct frame *(*get_frame) (void)) {
+	const struct file_page *info = text_info (page);
+	struct frame key, *frame = NULL;
+	struct hash_elem *e;
+
+	key.text_inode = file_get_inode (info->file);
+	key.text_ofs = info->ofs;
+	key.text_bytes = info->read_bytes;
+
+	/* Pinned, so that it stays put until it is mapped. */
+	lock_acquire (&frame_lock);
+	e = hash_find (&text_cache, &key.text_elem);
+	if (e != NULL) {
+		frame = hash_entry (e, struct frame, text_elem);
+		frame->pinned = true;
+	}
+	lock_release (&frame_lock);
+
+	if (frame != NULL) {
+		if (VM_TYPE (page->operations->type) == VM_UNINIT) {
+			struct file_page *aux = page->uninit.aux;
+
+			file_init_page (page, aux);
+			free (aux);
+		}
+		frame_link (frame, page);
+		if (!pml4_set_page (page->owner->pml4, page->va, frame->kva, false)) {
+			frame_unlink (page);
+			frame_set_pinned (frame, false);
+			return false;
+		}
+		frame_set_pinned (frame, false);
+		text_share_cnt++;
+		return true;
+	}
+
+	frame = get_frame ();
+	if (frame == NULL || !vm_claim_frame (page, frame))
+		return false;
+	if (page->writable)
+		pml4_protect_range (page->owner->pml4, page->va, 1, false);
+	lock_acquire (&frame_lock);
+	frame->text_inode = key.text_inode;
+	frame->text_ofs = key.text_ofs;
+	frame->text_bytes = key.text_bytes;
+	hash_insert (&text_cache, &frame->text_elem);
+	lock_release (&frame_lock);
+	text_read_cnt++;
+	return true;
+}
+
+/* Brings in PAGE, a page of a writable segment of the executable that
+ * has no frame and is being written, straight into a private frame,
+ * which it keeps as an anonymous page.  A frame that the text cache
+ * already holds is copied rather than read again. */
+static bool
+vm_map_private (struct page *page) {
+	const struct file_page *info = text_info (page);
+	struct frame key;
+	struct hash_elem *e;
+
+	ASSERT (info != NULL && page->writable);
+
+	key.text_inode = file_get_inode (info->file);
+	key.text_ofs = info->ofs;
+	key.text_bytes = info->read_bytes;
+	lock_acquire (&frame_lock);
+	e = hash_find (&text_cache, &key.text_elem);
+	lock_release (&frame_lock);
+	if (e != NULL)
+		return vm_map_text (page, vm_get_frame) && vm_handle_wp (page);
+
+	if (!vm_do_claim_page (page))
+		return false;
+	anon_init_page (page);
+	text_private_cnt++;
+	return true;
+}
+
+/* Unmaps all the pages that map FRAME, a text cache frame, so that it
+ * can be evicted.  Returns true if successful. */
+static bool
+text_swap_out (struct frame *frame) {
+	struct list_elem *e;
+
+	for (e = list_begin (&frame->pages); e != list_end (&frame->pages);
+			e = list_next (e))
+		if (!swap_out (list_entry (e, struct page, frame_elem)))
+			return false;
+	return true;
+}
+
+/* Returns true if PAGE has not been loaded yet and its contents come
+ * from a file. */
+static bool
+is_file_content (struct page *page) {
+	return VM_TYPE (page->operations->type) == VM_UNINIT
+		&& (page->uninit.init != NULL || VM_TYPE (page->uninit.type) == VM_FILE);
+}
+
+/* Clears the accessed bits of the WINDOW pages below VA, so that the
+ * clock evicts them first. */
+static void
+vm_age_behind (struct supplemental_page_table *spt, void *va, size_t window) {
+	uint8_t *upage = va;
+	size_t i;
+
+	for (i = 0; i < window && pg_no (upage) > 0; i++) {
+		struct page *page;
+
+		upage -= PGSIZE;
+		page = spt_find_page (spt, upage);
+		if (page != NULL && page->frame != NULL && page->owner->pml4 != NULL) {
+			check_around (page);
+			pml4_set_accessed (page->owner->pml4, page->va, false);
+			behind_cnt++;
+		}
+	}
+}
+
+/* Maps the pages around VA, which just faulted in, whose contents come
+ * from a file, in the aligned window of FAULT_AROUND_PAGES pages.  This
+ * saves a fault per page on sequential access.  If SEQUENTIAL, the
+ * window is larger and starts at VA instead, and the pages behind VA are
+ * aged.  It stops when no free frame is left, rather than evict for
+ * pages that may not be used. */
+static void
+vm_fault_around (struct supplemental_page_table *spt, void *va,
+		bool sequential) {
+	size_t window = fault_around_pages;
+	uint8_t *start, *upage;
+
+	if (window <= 1)
+		return;
+	around_fault_cnt++;
+	if (sequential) {
+		window *= SEQ_AROUND_SCALE;
+		start = va;
+		vm_age_behind (spt, va, window);
+	} else
+		start = (uint8_t *) va - pg_no (va) % window * PGSIZE;
+	for (upage = start; upage < start + window * PGSIZE
+			&& is_user_vaddr (upage); upage += PGSIZE) {
+		struct page *page = spt_find_page (spt, upage);
+		struct frame *frame;
+
+		if (page == NULL || page->frame != NULL || !is_file_content (page))
+			continue;
+		if (text_info (page) != NULL) {
+			if (!vm_map_text (page, frame_alloc))
+				break;
+		} else if ((frame = frame_alloc ()) == NULL
+				|| !vm_claim_frame (page, frame))
+			break;
+		page->around = true;
+		around_cnt++;
+	}
+}
+
+/* Accounts for PAGE, if it was mapped by fault-around and has not been
+ * checked yet, as a fault avoided if it has been accessed since.  Must
+ * be called before PAGE's accessed bit is cleared or its mapping goes
+ * away. */
+static void
+check_around (struct page *page) {
+	if (page->around && page->owner->pml4 != NULL) {
+		page->around = false;
+		if (pml4_is_accessed (page->owner->pml4, page->va))
+			around_used_cnt++;
+	}
+}
+
+/* Returns the swap readahead window of T for its next swap read, in
+ * pages, and starts counting its hits over. */
+static size_t
+swap_ra_window (struct thread *t) {
+	if (t->swap_ra_window == 0)
+		t->swap_ra_window = SWAP_RA_INIT;
+	else if (t->swap_ra_hits > 0 && t->swap_ra_window < SWAP_RA_MAX)
+		t->swap_ra_window *= 2;
+	else if (t->swap_ra_hits == 0 && t->swap_ra_window > SWAP_RA_MIN)
+		t->swap_ra_window /= 2;
+	t->swap_ra_hits = 0;
+	return t->swap_ra_window;
+}
+
+/* Returns the page with page number PG in SPT if it is swapped out to
+ * slot SLOT of the swap disk, or a null pointer. */
+static struct page *
+ra_candidate (struct supplemental_page_table *spt, uint64_t pg, size_t slot) {
+	struct page *page = radix_lookup (&spt->pages, pg);
+
+	if (page == NULL || page->frame != NULL
+			|| VM_TYPE (page->operations->type) != VM_ANON
+			|| page->anon.zentry != NULL || page->anon.slot != slot)
+		return NULL;
+	return page;
+}
+
+/* Brings PAGE, which is on the swap disk, back into memory and maps it,
+ * together with the pages next to it in SPT whose slots follow on from
+ * its own, as long as free frames last.  The run is read in one
+ * transfer.  The pages other than PAGE are left unmapped.  The caller
+ * must hold VM_LOCK. */
+static bool
+vm_swap_in_around (struct supplemental_page_table *spt, struct page *page) {
+	struct frame *frames[SWAP_RA_MAX];
+	struct page *pages[SWAP_RA_MAX];
+	void *kvas[SWAP_RA_MAX];
+	size_t window = swap_ra_window (page->owner);
+	size_t slot = page->anon.slot, cnt, i;
+	uint64_t pg = pg_no (page->va), start, end, lo, hi;
+
+	start = page->advice == MADV_SEQUENTIAL ? pg : pg - pg % window;
+	end = start + window;
+	frames[pg - start] = vm_get_frame ();
+	if (frames[pg - start] == NULL)
+		return false;
+
+	/* Grow the run forward, then backward, without evicting. */
+	for (hi = pg + 1; hi < end && ra_candidate (spt, hi, slot + (hi - pg))
+			&& (frames[hi - start] = frame_alloc ()) != NULL; hi++)
+		continue;
+	for (lo = pg; lo > start && slot >= pg - lo + 1
+			&& ra_candidate (spt, lo - 1, slot - (pg - lo + 1))
+			&& (frames[lo - 1 - start] = frame_alloc ()) != NULL; lo--)
+		continue;
+
+	cnt = hi - lo;
+	for (i = 0; i < cnt; i++) {
+		pages[i] = radix_lookup (&spt->pages, lo + i);
+		kvas[i] = frames[lo - start + i]->kva;
+	}
+	anon_swap_in_run (pages, kvas, cnt);
+	if (cnt > 1) {
+		ra_read_cnt++;
+		ra_page_cnt += cnt - 1;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		struct page *p = pages[i];
+		struct frame *frame = frames[lo - start + i];
+
+		frame_link (frame, p);
+		if (p == page)
+			continue;
+		/* Bits left over from the page's last mapping would make it
+		 * look used or dirty to the clock. */
+		pml4_set_accessed (p->owner->pml4, p->va, false);
+		pml4_set_dirty (p->owner->pml4, p->va, false);
+		p->readahead = true;
+		frame_set_pinned (frame, false);
+	}
+
+	if (!pml4_set_page (page->owner->pml4, page->va, page->frame->kva,
+				page->writable)) {
+		vm_free_frame (page);
+		return false;
+	}
+	frame_set_pinned (page->frame, false);
+	return true;
+}
+
+/* Maps PAGE, which swap readahead brought into memory.  HIT says
+ * whether it is being mapped because it was touched. */
+static bool
+vm_map_readahead (struct page *page, bool hit) {
+	page->readahead = false;
+	if (hit) {
+		page->owner->swap_ra_hits++;
+		ra_hit_cnt++;
+	}
+	return pml4_set_page (page->owner->pml4, page->va, page->frame->kva,
+			page->writable);
+}
+
+/* Accounts for a page fault by T, and adjusts its frame quota if it has
+ * been faulting much more or less than PFF_HIGH or PFF_LOW times per
+ * PFF_WINDOW ticks. */
+static void
+pff_fault (struct thread *t) {
+	int64_t elapsed;
+
+	t->fault_cnt++;
+	if (!pff_enabled)
+		return;
+
+	lock_acquire (&frame_lock);
+	if (t->frame_quota == 0) {
+		t->frame_quota = PFF_MIN;
+		quota_total += PFF_MIN;
+		t->pff_start = timer_ticks ();
+		t->pff_faults = 0;
+	}
+	t->pff_faults++;
+	elapsed = timer_elapsed (t->pff_start);
+	if (elapsed >= PFF_WINDOW) {
+		size_t rate = t->pff_faults * PFF_WINDOW / elapsed;
+
+		if (rate > PFF_HIGH && t->rss >= t->frame_quota
+				&& quota_total + PFF_STEP <= frame_cnt) {
+			t->frame_quota += PFF_STEP;
+			quota_total += PFF_STEP;
+			quota_grow_cnt++;
+		} else if (rate < PFF_LOW) {
+			size_t quota = t->rss > PFF_MIN ? t->rss : PFF_MIN;
+
+			if (quota < t->frame_quota) {
+				quota_total -= t->frame_quota - quota;
+				t->frame_quota = quota;
+				quota_shrink_cnt++;
+			}
+		}
+		t->pff_start = timer_ticks ();
+		t->pff_faults = 0;
+	}
+	quota_check (t);
+	lock_release (&frame_lock);
+}
+
+/* Stores the current process's virtual memory counters in *ST. */
+void
+vm_get_procstat (struct procstat *st) {
+	struct thread *t = thread_current ();
+
+	uint64_t handled = 0;
+	size_t i;
+
+	lock_acquire (&vm_lock);
+	lock_acquire (&frame_lock);
+	st->resident_pages = t->rss;
+	st->frame_quota = t->frame_quota;
+	st->fault_cnt = t->fault_cnt;
+	st->evicted_cnt = t->evicted_cnt;
+	lock_release (&frame_lock);
+	for (i = 0; i < FAULT_CLASS_CNT; i++) {
+		st->class_cnt[i] = t->fault_class_cnt[i];
+		if (i != FAULT_INVALID)
+			handled += t->fault_class_cnt[i];
+	}
+	st->major_cnt = t->major_cnt;
+	st->minor_cnt = handled - t->major_cnt;
+	st->swap_in_cnt = t->swap_in_cnt;
+	st->swap_out_cnt = t->swap_out_cnt;
+	st->pagetable_pages = pml4_table_pages (t->pml4);
+	lock_release (&vm_lock);
+}
+
+/* Stores the system's page fault statistics in *ST. */
+void
+vm_get_faultstat (struct faultstat *st) {
+	lock_acquire (&vm_lock);
+	memcpy (st->classes, fault_stats, sizeof fault_stats);
+	lock_release (&vm_lock);
+}
+
+/* Returns the class of a fault on PAGE, which is not mapped. */
+static enum fault_class
+page_fault_class (struct page *page) {
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_UNINIT:
+			if (VM_TYPE (page->uninit.type) == VM_FILE)
+				return FAULT_FILE;
+			return page->uninit.init != NULL ? FAULT_LAZY : FAULT_ZERO;
+		case VM_ANON:
+			return FAULT_SWAP;
+		default:
+			return FAULT_FILE;
+	}
+}
+
+/* Returns true if bringing in PAGE, of fault class CLASS, reads it
+ * from disk, unless it comes from the text cache. */
+static bool
+page_fault_is_major (struct page *page, enum fault_class class) {
+	switch (class) {
+		case FAULT_LAZY:
+			return true;
+		case FAULT_SWAP:
+			return page->frame == NULL && page->anon.zentry == NULL;
+		case FAULT_FILE:
+			return text_info (page) == NULL;
+		default:
+			return false;
+	}
+}
+
+/* Accounts for a fault by T of class CLASS, that took CYCLES CPU
+ * cycles. */
+static void
+fault_account (struct thread *t, enum fault_class class, uint64_t cycles) {
+	struct fault_class_stat *fs = &fault_stats[class];
+	size_t bucket = 0;
+	uint64_t c;
+
+	for (c = cycles >> FAULT_HIST_SHIFT; c > 0 && bucket < FAULT_HIST_CNT - 1;
+			c >>= 2)
+		bucket++;
+	fs->cnt++;
+	fs->cycles += cycles;
+	if (cycles > fs->max_cycles)
+		fs->max_cycles = cycles;
+	fs->hist[bucket]++;
+
+	t->fault_class_cnt[class]++;
+}
+
+/* Reports the current process's page faults, so that tests can check
+ * how many faults an access pattern costs.  Called via int 0x43.
+ * Input:
+ *   @RAX - Fault class, or FAULT_CLASS_CNT for major faults
+ * Output:
+ *   @RAX - Faults of that class taken by the process, or -1 if RAX
+ *          is out of range. */
+static void
+fault_inspect (struct intr_frame *f) {
+	struct thread *t = thread_current ();
+	uint64_t class = f->R.rax;
+
+	if (class < FAULT_CLASS_CNT)
+		f->R.rax = t->fault_class_cnt[class];
+	else if (class == FAULT_CLASS_CNT)
+		f->R.rax = t->major_cnt;
+	else
+		f->R.rax = -1;
+}
+
+/* Returns true if a fault at ADDR, with the user stack pointer at RSP,
+ * should grow the stack.  PUSH may fault 8 bytes below RSP. */
+static bool
+is_stack_access (void *addr, void *rsp) {
+	return (uint8_t *) addr >= (uint8_t *) rsp - 8
+		&& (uint8_t *) addr < (uint8_t *) USER_STACK
+		&& (uint8_t *) addr >= (uint8_t *) USER_STACK - STACK_MAX;
+}
+
+/* Return true on success */
+bool
+vm_try_handle_fault (struct intr_frame *f, void *addr,
+		bool user, bool write, bool not_present) {
+	struct thread *t = thread_current ();
+	struct supplemental_page_table *spt = &t->spt;
+	uint64_t start = rdtsc (), text_reads;
+	enum fault_class class = FAULT_INVALID;
+	struct page *page;
+	bool success = false, major, around;
+
+	lock_acquire (&vm_lock);
+	if (addr == NULL || !is_user_vaddr (addr))
+		goto done;
+	page = spt_find_page (spt, addr);
+	if (!not_present) {
+		success = page != NULL && write && page->writable
+			&& vm_handle_wp (page);
+		class = FAULT_COW;
+		goto done;
+	}
+
+	if (page == NULL) {
+		struct vma *v = vma_find (&spt->vmas, addr);
+
+		/* Outside the VMAs, only the stack may grow.  A fault in the
+		 * kernel during a system call sees the kernel stack pointer in
+		 * F, so use the one saved on entry. */
+		if (v != NULL && vm_alloc_huge (v, addr)) {
+			fault_cnt++;
+			pff_fault (t);
+			class = FAULT_ZERO;
+			success = true;
+			goto done;
+		} else if (v != NULL)
+			vm_alloc_vma_page (v, pg_round_down (addr));
+		else if (is_stack_access (addr, user ? (void *) f->rsp : t->user_rsp))
+			vm_stack_growth (addr);
+		else
+			goto done;
+		page = spt_find_page (spt, addr);
+		if (page == NULL)
+			goto done;
+		class = v != NULL ? page_fault_class (page) : FAULT_STACK;
+	} else
+		class = page_fault_class (page);
+	if (write && !page->writable)
+		goto done;
+	major = page_fault_is_major (page, class);
+	text_reads = text_read_cnt + text_private_cnt;
+
+	fault_cnt++;
+	pff_fault (t);
+	if (!write && is_zero_fill (page)) {
+		success = vm_map_zero (page);
+		goto done;
+	}
+	if (page->readahead) {
+		success = vm_map_readahead (page, true);
+		goto done;
+	}
+	around = is_file_content (page) && page->advice != MADV_RANDOM;
+	if (text_info (page) != NULL && write)
+		success = vm_map_private (page);
+	else if (text_info (page) != NULL)
+		success = vm_map_text (page, vm_get_frame);
+	else if (class == FAULT_SWAP && major && page->advice != MADV_RANDOM)
+		success = vm_swap_in_around (spt, page);
+	else
+		success = vm_do_claim_page (page);
+	if (success && around)
+		vm_fault_around (spt, page->va, page->advice == MADV_SEQUENTIAL);
+	/* Fault-around, or a write to a data page, may have read the
+	 * file too. */
+	if (success && (major || text_read_cnt + text_private_cnt != text_reads))
+		t->major_cnt++;
+done:
+	fault_account (t, success ? class : FAULT_INVALID, rdtsc () - start);
+	lock_release (&vm_lock);
+	return success;
+}
+
+/* Free the page.
+ * DO NOT MODIFY THIS FUNCTION. */
+void
+vm_dealloc_page (struct page *page) {
+	destroy (page);
+	free (page);
+}
+
+/* Claim the page that allocate on VA. */
+bool
+vm_claim_page (void *va) {
+	struct page *page;
+	bool success = false;
+
+	/* Another thread's eviction may split a huge page of ours, which
+	 * inserts into the spt, so look up under VM_LOCK too. */
+	lock_acquire (&vm_lock);
+	page = spt_find_page (&thread_current ()->spt, va);
+	if (page != NULL)
+		success = vm_do_claim_page (page);
+	lock_release (&vm_lock);
+	return success;
+}
+
+/* Returns true if the current process may access the user page at VA,
+ * and write to it if WRITE, whether or not the page is in memory. */
+bool
+vm_user_page_ok (const void *va, bool write) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page;
+	struct vma *vma;
+	bool ok;
+
+	lock_acquire (&vm_lock);
+	page = spt_find_page (spt, (void *) va);
+	if (page != NULL)
+		ok = !write || page->writable;
+	else {
+		vma = vma_find (&spt->vmas, va);
+		ok = vma != NULL && (!write || vma->writable);
+	}
+	lock_release (&vm_lock);
+	return ok;
+}
+
+/* Claim the PAGE and set up the mmu.  The caller must hold VM_LOCK. */
+static bool
+vm_do_claim_page (struct page *page) {
+	struct frame *frame = vm_get_frame ();
+
+	if (frame == NULL)
+		return false;
+	return vm_claim_frame (page, frame);
+}
+
+/* Brings PAGE into FRAME, which must be pinned and map no page, and
+ * maps it.  Frees FRAME on failure. */
+static bool
+vm_claim_frame (struct page *page, struct frame *frame) {
+	/* Set links */
+	frame_link (frame, page);
+
+	if (!pml4_set_page (page->owner->pml4, page->va, frame->kva,
+				page->writable) || !swap_in (page, frame->kva)) {
+		vm_free_frame (page);
+		return false;
+	}
+	frame_set_pinned (frame, false);
+	return true;
+}
+
+/* Moves the current process's program break to ADDR and returns the
+ * new break.  The range that the heap gains becomes zero-filled
+ * anonymous memory, whose pages are only created when touched, and
+ * pages that it loses are freed.  If ADDR is null, below the start of
+ * the heap, reaches into the stack region or collides with another
+ * mapping, the break is unchanged and the old break is returned. */
+void *
+vm_brk (void *addr) {
+	struct thread *t = thread_current ();
+	struct supplemental_page_table *spt = &t->spt;
+	uint8_t *old_top = pg_round_up (t->heap_end);
+	uint8_t *new_top = pg_round_up (addr);
+	bool success = true;
+
+	if ((uint8_t *) addr < (uint8_t *) t->heap_start
+			|| (uint8_t *) addr > (uint8_t *) USER_STACK - STACK_MAX)
+		return t->heap_end;
+
+	lock_acquire (&vm_lock);
+	if (new_top > old_top)
+		success = vma_map (&spt->vmas, old_top, new_top, VM_ANON, NULL, 0,
+				true);
+	else if (new_top < old_top) {
+		success = huge_prepare (spt, new_top, old_top, true)
+			&& vma_unmap (&spt->vmas, new_top, old_top);
+		if (success)
+			spt_remove_range (spt, new_top, old_top);
+	}
+	lock_release (&vm_lock);
+	if (!success)
+		return t->heap_end;
+
+	t->heap_end = addr;
+	return addr;
+}
+
+/* Reads PAGE in ahead of use, if its contents are somewhere other than
+ * memory, using free frames only.  Returns false if none is left. */
+static bool
+vm_prefetch_page (struct page *page) {
+	struct frame *frame;
+
+	if (page->frame != NULL || is_zero_fill (page))
+		return true;
+	if (text_info (page) != NULL) {
+		if (!vm_map_text (page, frame_alloc))
+			return false;
+	} else if ((frame = frame_alloc ()) == NULL
+			|| !vm_claim_frame (page, frame))
+		return false;
+	willneed_cnt++;
+	return true;
+}
+
+/* Frees the frame of PAGE, in SPT.  A file-backed page reads its
+ * contents back from the file when next touched, after writing them
+ * back if it is dirty, and an anonymous page is removed, so that it
+ * starts over as zero-filled memory.  Pages that have not been loaded
+ * yet are left alone. */
+static void
+vm_drop_page (struct supplemental_page_table *spt, struct page *page) {
+	switch (VM_TYPE (page->operations->type)) {
+		case VM_FILE:
+			if (page->frame != NULL) {
+				if (page_needs_writeback (page)) {
+					frame_set_pinned (page->frame, true);
+					writeback_pages (&page, 1);
+				}
+				vm_free_frame (page);
+				dontneed_cnt++;
+			}
+			break;
+		case VM_ANON:
+			if (page->frame != NULL)
+				dontneed_cnt++;
+			spt_remove_page (spt, page);
+			break;
+		default:
+			break;
+	}
+}
+
+/* Applies ADVICE, one of the MADV_* values in <madvise.h>, to the
+ * pages of the current process that overlap the LENGTH bytes at ADDR,
+ * which must be page-aligned.  Returns 0 if successful, or -1 if the
+ * advice is unknown, part of the range is not mapped, or MADV_POPULATE
+ * runs out of memory. */
+int
+vm_madvise (void *addr, size_t length, int advice) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *start = addr, *end = start + length, *upage;
+	int result = 0;
+
+	if (pg_ofs (addr) != 0 || end < start || advice < MADV_NORMAL
+			|| advice > MADV_POPULATE)
+		return -1;
+	if (length == 0)
+		return 0;
+	if (!is_user_vaddr (start) || !is_user_vaddr (end - 1))
+		return -1;
+	end = pg_round_up (end);
+
+	lock_acquire (&vm_lock);
+	if (!vma_covers (&spt->vmas, start, end)
+			|| (advice == MADV_DONTNEED
+				&& !huge_prepare (spt, start, end, true))) {
+		result = -1;
+		goto done;
+	}
+	/* Pages made later take the access pattern from their VMA. */
+	if ((advice == MADV_NORMAL || advice == MADV_RANDOM
+				|| advice == MADV_SEQUENTIAL)
+			&& !vma_advise (&spt->vmas, start, end, advice)) {
+		result = -1;
+		goto done;
+	}
+
+	for (upage = start; upage < end; upage += PGSIZE) {
+		struct page *page = spt_find_page (spt, upage);
+
+		/* A page that does not exist yet is zero-filled memory, which
+		 * only MADV_POPULATE has anything to do for, unless it is part
+		 * of a huge page, which is always in memory.  Its VMA keeps
+		 * any other advice. */
+		if (page == NULL) {
+			if (advice != MADV_POPULATE || huge_find (spt, upage) != NULL)
+				continue;
+			if (!vm_alloc_vma_page (vma_find (&spt->vmas, upage), upage)) {
+				result = -1;
+				goto done;
+			}
+			page = spt_find_page (spt, upage);
+		}
+
+		switch (advice) {
+			case MADV_NORMAL:
+			case MADV_RANDOM:
+			case MADV_SEQUENTIAL:
+				page->advice = advice;
+				break;
+			case MADV_WILLNEED:
+				/* Only a hint, so it is not an error to run out. */
+				if (!vm_prefetch_page (page))
+					goto done;
+				break;
+			case MADV_DONTNEED:
+				vm_drop_page (spt, page);
+				break;
+			case MADV_POPULATE:
+				if (page->frame != NULL)
+					break;
+				if (!(text_info (page) != NULL
+							? vm_map_text (page, vm_get_frame)
+							: vm_do_claim_page (page))) {
+					result = -1;
+					goto done;
+				}
+				populate_cnt++;
+				break;
+		}
+	}
+done:
+	lock_release (&vm_lock);
+	return result;
+}
+
+/* Writes back the dirty pages of the file mappings of the current
+ * process that overlap the LENGTH bytes at ADDR, which must be
+ * page-aligned.  FLAGS is MS_SYNC, to write them before returning, or
+ * MS_ASYNC, to have kflushd write them soon.  Returns 0 if successful,
+ * or -1 if FLAGS is invalid or part of the range is not mapped. */
+int
+vm_msync (void *addr, size_t length, int flags) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint8_t *start = addr, *end = start + length;
+	int result = 0;
+
+	if (pg_ofs (addr) != 0 || end < start
+			|| (flags != MS_SYNC && flags != MS_ASYNC))
+		return -1;
+	if (length == 0)
+		return 0;
+	if (!is_user_vaddr (start) || !is_user_vaddr (end - 1))
+		return -1;
+	end = pg_round_up (end);
+
+	lock_acquire (&vm_lock);
+	msync_cnt++;
+	if (!vma_covers (&spt->vmas, start, end))
+		result = -1;
+	else if (flags == MS_SYNC)
+		spt_writeback (spt, start, end);
+	else if (!flush_woken) {
+		flush_woken = true;
+		sema_up (&flush_sema);
+	}
+	lock_release (&vm_lock);
+	return result;
+}
+
+/* Removes file mapping V from SPT, writing back its dirty pages, and
+ * closes its file.  The caller must hold VM_LOCK. */
+static void
+unmap_mapping (struct supplemental_page_table *spt, struct vma *v) {
+	struct file *file = v->file;
+	uint8_t *start = v->start, *end = v->end;
+
+	ASSERT (v->type & VM_MMAP);
+
+	spt_writeback (spt, start, end);
+	spt_remove_range (spt, start, end);
+	/* Removing a whole VMA never needs memory. */
+	vma_unmap (&spt->vmas, start, end);
+	file_close (file);
+}
+
+/* Maps [START, END) of the current process, which must be
+ * page-aligned, to FILE from offset OFS, without creating any page.
+ * Returns false if the range overlaps another mapping. */
+bool
+vm_map_file (void *start, void *end, struct file *file, off_t ofs,
+		bool writable) {
+	bool success;
+
+	lock_acquire (&vm_lock);
+	success = vma_map (&thread_current ()->spt.vmas, start, end,
+			VM_FILE | VM_MMAP, file, ofs, writable);
+	lock_release (&vm_lock);
+	return success;
+}
+
+/* Removes the file mapping that starts at ADDR from the current
+ * process, if there is one. */
+void
+vm_unmap_mapping (void *addr) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct vma *v;
+
+	lock_acquire (&vm_lock);
+	v = vma_find (&spt->vmas, addr);
+	if (v != NULL && v->start == addr && (v->type & VM_MMAP))
+		unmap_mapping (spt, v);
+	lock_release (&vm_lock);
+}
+
+/* Initialize new supplemental page table */
+void
+supplemental_page_table_init (struct supplemental_page_table *spt) {
+	radix_init (&spt->pages);
+	list_init (&spt->vmas);
+	list_init (&spt->huges);
+}
+
+/* Adds to the current process a lazy copy of SRC, a file-backed page of
+ * its parent's executable, that reads from the current process's own
+ * copy of the executable.  Once faulted in, both map the text cache
+ * frame. */
+static bool
+vm_copy_file_page (struct page *src) {
+	const struct file_page *info = VM_TYPE (src->operations->type) == VM_FILE
+		? &src->file : src->uninit.aux;
+	struct file_page *aux;
+
+	ASSERT (info->file == src->owner->running_file);
+
+	aux = malloc (sizeof *aux);
+	if (aux == NULL)
+		return false;
+	*aux = *info;
+	aux->file = thread_current ()->running_file;
+	if (!vm_alloc_page_with_initializer (VM_FILE, src->va, src->writable,
+				NULL, aux)) {
+		free (aux);
+		return false;
+	}
+	return true;
+}
+
+/* Adds to DST, the current process's spt, a copy of SRC_PAGE, a page of
+ * its parent.  Called for each page of the parent's spt by
+ * supplemental_page_table_copy(); returns false on failure, which stops
+ * the copy. */
+static bool
+copy_page (uint64_t key UNUSED, void *src_page_, void *dst_) {
+	struct page *src_page = src_page_;
+	struct supplemental_page_table *dst = dst_;
+	struct page *dst_page;
+
+	if (is_exec_page (src_page))
+		return vm_copy_file_page (src_page);
+	if (VM_TYPE (src_page->operations->type) == VM_UNINIT
+			&& src_page->uninit.aux == NULL)
+		return vm_alloc_page_with_initializer (src_page->uninit.type,
+				src_page->va, src_page->writable, src_page->uninit.init,
+				NULL);
+
+	/* The child's page is anonymous even if the parent's page is
+	 * backed by a file: it becomes private once written. */
+	if (!vm_alloc_page (VM_ANON, src_page->va, src_page->writable))
+		return false;
+	dst_page = spt_find_page (dst, src_page->va);
+	anon_init_page (dst_page);
+
+	/* A swapped-out anonymous page stays out.  The child's page refers
+	 * to the same swap slot, or to a copy of the compressed page, and
+	 * reads it in at its first fault. */
+	if (src_page->frame == NULL
+			&& VM_TYPE (src_page->operations->type) == VM_ANON
+			&& anon_copy_swapped (dst_page, src_page)) {
+		cow_share_cnt++;
+		cow_swap_cnt++;
+		return true;
+	}
+	if (src_page->frame == NULL && !vm_do_claim_page (src_page))
+		return false;
+	if (src_page->readahead && !vm_map_readahead (src_page, false))
+		return false;
+	frame_link (src_page->frame, dst_page);
+	pml4_protect_range (src_page->owner->pml4, src_page->va, 1, false);
+	cow_share_cnt++;
+	return pml4_set_page (dst_page->owner->pml4, dst_page->va,
+			src_page->frame->kva, false);
+}
+
+/* Copy supplemental page table from src to dst, copy-on-write.
+ * The child gets the parent's VMAs, so that zero-filled memory that
+ * the parent has not touched yet costs the child nothing either.
+ * Zero-filled pages that are lazy in the parent stay lazy in the
+ * child, and so do pages of the executable's text.  Anonymous pages
+ * that are swapped out stay out, and the child's copy shares their
+ * swap slot.  Other pages are brought into the parent first, and then
+ * the child's page maps the same frame.  Both map it read-only, so
+ * that the first write by either makes a private copy. */
+bool
+supplemental_page_table_copy (struct supplemental_page_table *dst,
+		struct supplemental_page_table *src) {
+	/* SRC is embedded in the parent's struct thread. */
+	struct thread *parent = (struct thread *) ((uint8_t *) src
+			- offsetof (struct thread, spt));
+	bool success;
+
+	struct list_elem *e;
+
+	lock_acquire (&vm_lock);
+	/* Huge pages are shared page by page. */
+	success = huge_prepare (src, NULL, (void *) KERN_BASE, false)
+		&& vma_copy (&dst->vmas, &src->vmas, parent->running_file,
+			thread_current ()->running_file);
+	/* The child's file mappings hold their own references to their
+	 * files.  A failed reopen leaves no file to close at exit. */
+	for (e = list_begin (&dst->vmas); e != list_end (&dst->vmas);
+			e = list_next (e)) {
+		struct vma *v = list_entry (e, struct vma, elem);
+
+		if (success && (v->type & VM_MMAP)) {
+			v->file = file_reopen (v->file);
+			success = v->file != NULL;
+		} else if (v->type & VM_MMAP)
+			v->file = NULL;
+	}
+	success = success
+		&& radix_walk (&src->pages, 0, RADIX_KEY_MAX, copy_page, dst);
+	lock_release (&vm_lock);
+	return success;
+}
+
+/* Free the resource hold by the supplemental page table.  The table
+ * itself stays usable, since process_exec() loads the new image into
+ * it.  The process gives up its frame quota too, and gets a new one at
+ * its next fault. */
+void
+supplemental_page_table_kill (struct supplemental_page_table *spt) {
+	struct thread *t = thread_current ();
+
+	struct list_elem *e;
+
+	lock_acquire (&vm_lock);
+	/* File mappings are written back before their pages go away. */
+	for (e = list_begin (&spt->vmas); e != list_end (&spt->vmas); ) {
+		struct vma *v = list_entry (e, struct vma, elem);
+
+		e = list_next (e);
+		if (v->type & VM_MMAP) {
+			if (v->file != NULL)
+				unmap_mapping (spt, v);
+			else
+				vma_unmap (&spt->vmas, v->start, v->end);
+		}
+	}
+	huge_prepare (spt, NULL, (void *) KERN_BASE, true);
+	radix_remove_range (&spt->pages, 0, RADIX_KEY_MAX, page_destructor, NULL);
+	vma_clear (&spt->vmas);
+	lock_acquire (&frame_lock);
+	quota_total -= t->frame_quota;
+	t->frame_quota = 0;
+	quota_check (t);
+	lock_release (&frame_lock);
+	lock_release (&vm_lock);
 }
@@ -0,0 +1,240 @@
+/* vma.c: Ranges of a process's address space that are mapped. */
+
+#include "vm/vma.h"
+#include <debug.h>
+#include <madvise.h>
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+/* A process's VMAs are kept in a list sorted by address, and never
+ * overlap.  Processes have a handful of them (text, data, heap, stack),
+ * so a list is as fast as a search tree here, and a lookup seldom goes
+ * past the first few elements.  Adjacent anonymous VMAs with the same
+ * attributes are merged, so that a heap grown a page at a time stays a
+ * single VMA.  The access pattern advice given with madvise() is an
+ * attribute too, so advice on part of a VMA splits it. */
+
+/* Returns the VMA in VMAS that contains VA, or a null pointer if VA is
+ * not mapped. */
+struct vma *
+vma_find (struct list *vmas, const void *va) {
+	struct list_elem *e;
+
+	for (e = list_begin (vmas); e != list_end (vmas); e = list_next (e)) {
+		struct vma *v = list_entry (e, struct vma, elem);
+
+		if ((const uint8_t *) va < v->start)
+			break;
+		if ((const uint8_t *) va < v->end)
+			return v;
+	}
+	return NULL;
+}
+
+/* Returns true if every byte of [START, END) is in some VMA of VMAS. */
+bool
+vma_covers (struct list *vmas, const void *start, const void *end) {
+	const uint8_t *p = start;
+	struct vma *v;
+
+	while (p < (const uint8_t *) end) {
+		v = vma_find (vmas, p);
+		if (v == NULL)
+			return false;
+		p = v->end;
+	}
+	return true;
+}
+
+/* Returns true if A and B, which are adjacent, can be one VMA. */
+static bool
+vma_mergeable (const struct vma *a, const struct vma *b) {
+	return a->end == b->start && a->file == NULL && b->file == NULL
+		&& a->type == b->type && a->writable == b->writable
+		&& a->advice == b->advice;
+}
+
+/* Adds the range [START, END), which must be page-aligned, to VMAS as a
+ * mapping of TYPE, from OFS in FILE if FILE is not null.  Returns false
+ * if the range overlaps a VMA already in VMAS or memory is short. */
+bool
+vma_map (struct list *vmas, void *start_, void *end_, int type,
+		struct file *file, off_t ofs, bool writable) {
+	uint8_t *start = start_, *end = end_;
+	struct list_elem *e;
+	struct vma *v, *prev = NULL, *next = NULL;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+	ASSERT (start < end);
+
+	for (e = list_begin (vmas); e != list_end (vmas); e = list_next (e)) {
+		v = list_entry (e, struct vma, elem);
+		if (v->start >= end) {
+			next = v;
+			break;
+		}
+		if (v->end > start)
+			return false;
+		prev = v;
+	}
+
+	v = malloc (sizeof *v);
+	if (v == NULL)
+		return false;
+	v->start = start;
+	v->end = end;
+	v->type = type;
+	v->file = file;
+	v->ofs = ofs;
+	v->writable = writable;
+	v->advice = MADV_NORMAL;
+
+	if (prev != NULL && vma_mergeable (prev, v)) {
+		prev->end = end;
+		free (v);
+		v = prev;
+	} else
+		list_insert (next != NULL ? &next->elem : list_end (vmas), &v->elem);
+	if (next != NULL && vma_mergeable (v, next)) {
+		v->end = next->end;
+		list_remove (&next->elem);
+		free (next);
+	}
+	return true;
+}
+
+/* Splits V in two at MID, which must be page-aligned and inside V, and
+ * returns the second part, or a null pointer if memory is short. */
+static struct vma *
+vma_split (struct vma *v, uint8_t *mid) {
+	struct vma *tail = malloc (sizeof *tail);
+
+	if (tail == NULL)
+		return NULL;
+	*tail = *v;
+	tail->start = mid;
+	tail->ofs += mid - v->start;
+	v->end = mid;
+	list_insert (list_next (&v->elem), &tail->elem);
+	return tail;
+}
+
+/* Removes the range [START, END), which must be page-aligned, from the
+ * VMAs of VMAS, trimming or splitting the ones that it overlaps.
+ * Returns false, and leaves VMAS unchanged, if memory is short. */
+bool
+vma_unmap (struct list *vmas, void *start_, void *end_) {
+	uint8_t *start = start_, *end = end_;
+	struct list_elem *e, *next;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+
+	for (e = list_begin (vmas); e != list_end (vmas); e = next) {
+		struct vma *v = list_entry (e, struct vma, elem);
+
+		next = list_next (e);
+		if (v->start >= end)
+			break;
+		if (v->end <= start)
+			continue;
+
+		if (v->start < start && v->end > end) {
+			/* Only a split needs memory, and it can only be the one
+			 * VMA that the range touches, so nothing has changed yet. */
+			if (vma_split (v, end) == NULL)
+				return false;
+			v->end = start;
+			break;
+		} else if (v->start < start)
+			v->end = start;
+		else if (v->end > end) {
+			v->ofs += end - v->start;
+			v->start = end;
+		} else {
+			list_remove (e);
+			free (v);
+		}
+	}
+	return true;
+}
+
+/* Records ADVICE, MADV_NORMAL, MADV_RANDOM or MADV_SEQUENTIAL, for the
+ * range [START, END), which must be page-aligned, in the VMAs of VMAS
+ * that it overlaps, splitting those that it covers only in part.
+ * Returns false if memory is short, in which case only part of the
+ * range may have the advice. */
+bool
+vma_advise (struct list *vmas, void *start_, void *end_, int advice) {
+	uint8_t *start = start_, *end = end_;
+	struct list_elem *e, *first = NULL;
+
+	ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+
+	for (e = list_begin (vmas); e != list_end (vmas); e = list_next (e)) {
+		struct vma *v = list_entry (e, struct vma, elem);
+
+		if (v->start >= end)
+			break;
+		if (v->end < start)
+			continue;
+		if (first == NULL)
+			first = e;
+		if (v->end == start || v->advice == advice)
+			continue;
+		if (v->start < start && (v = vma_split (v, start)) == NULL)
+			return false;
+		if (v->end > end && vma_split (v, end) == NULL)
+			return false;
+		v->advice = advice;
+		e = &v->elem;
+	}
+
+	/* Put back together the VMAs that the advice no longer tells
+	 * apart, including those that end or start the range. */
+	for (e = first; e != NULL && e != list_end (vmas); ) {
+		struct vma *v = list_entry (e, struct vma, elem);
+		struct list_elem *next = list_next (e);
+		struct vma *w;
+
+		if (v->start >= end || next == list_end (vmas))
+			break;
+		w = list_entry (next, struct vma, elem);
+		if (vma_mergeable (v, w)) {
+			v->end = w->end;
+			list_remove (next);
+			free (w);
+		} else
+			e = next;
+	}
+	return true;
+}
+
+/* Copies the VMAs of SRC into DST, which must be empty.  VMAs mapped
+ * from FROM map TO in DST.  Returns false if memory is short. */
+bool
+vma_copy (struct list *dst, struct list *src, struct file *from,
+		struct file *to) {
+	struct list_elem *e;
+
+	ASSERT (list_empty (dst));
+
+	for (e = list_begin (src); e != list_end (src); e = list_next (e)) {
+		struct vma *v = list_entry (e, struct vma, elem);
+		struct vma *copy = malloc (sizeof *copy);
+
+		if (copy == NULL)
+			return false;
+		*copy = *v;
+		if (from != NULL && copy->file == from)
+			copy->file = to;
+		list_push_back (dst, &copy->elem);
+	}
+	return true;
+}
+
+/* Removes all the VMAs from VMAS. */
+void
+vma_clear (struct list *vmas) {
+	while (!list_empty (vmas))
+		free (list_entry (list_pop_front (vmas), struct vma, elem));
+}
@@ -0,0 +1,395 @@
+/* zswap.c: Compressed cache for swapped-out anonymous pages. */
+
+#include "vm/zswap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Anonymous pages that are evicted are compressed into this cache
+ * instead of going to the swap disk, when they compress well.  Faults
+ * on them then cost a decompression rather than a disk read.
+ *
+ * The compressed pages are kept in pool pages allocated from the
+ * kernel pool, at most ZSWAP_PAGE_LIMIT of them.  Each pool page is cut
+ * into CHUNK_CNT chunks of CHUNK_SIZE bytes, the first of which holds
+ * the pool page's header, and a compressed page takes a run of chunks
+ * within one pool page.  When the cache is full, the anonymous page
+ * code writes the oldest entries, found with zswap_oldest(), to disk.
+ *
+ * The compressor is a byte-oriented LZ77 in the style of LZ4: a hash
+ * of the next 4 bytes finds an earlier occurrence in the same page, and
+ * the output is a mix of literal runs and back references. */
+
+#define CHUNK_SIZE 64
+#define CHUNK_CNT (PGSIZE / CHUNK_SIZE)
+
+/* Largest compressed page worth keeping.  Pages that do not compress
+ * below it are rejected as incompressible. */
+#define MAX_SIZE (PGSIZE / 4 * 3)
+
+/* A page of the pool.  The header lives in the page's first chunk. */
+struct zpage {
+	struct list_elem elem;      /* Element in zpages. */
+	uint64_t used;              /* Bitmap of chunks in use. */
+};
+
+/* A compressed page. */
+struct zswap_entry {
+	struct list_elem elem;      /* Element in lru, oldest first. */
+	struct page *page;          /* Page compressed. */
+	struct zpage *zpage;        /* Pool page that holds the data. */
+	uint8_t chunk;              /* First chunk in ZPAGE. */
+	uint8_t chunk_cnt;          /* Chunks in use. */
+	uint16_t size;              /* Bytes of compressed data. */
+};
+
+size_t zswap_page_limit = 256;
+
+static struct lock zswap_lock;
+static struct list zpages;              /* Pool pages. */
+static size_t zpage_cnt;                /* Elements in zpages. */
+static struct list lru;                 /* Entries, oldest first. */
+static uint8_t scratch[MAX_SIZE];       /* Compressor output. */
+
+/* Statistics. */
+static size_t stored_cnt;               /* Entries in the cache. */
+static size_t stored_bytes;             /* Compressed bytes in the cache. */
+static uint64_t store_cnt;              /* Pages stored. */
+static uint64_t load_cnt;               /* Pages loaded. */
+static uint64_t reject_cnt;             /* Pages rejected. */
+static uint64_t full_cnt;               /* Stores refused for lack of room. */
+static uint64_t size_hist[3];           /* Stores by compressed quarter page. */
+
+/* Sets up the compressed cache. */
+void
+zswap_init (void) {
+	lock_init (&zswap_lock);
+	list_init (&zpages);
+	list_init (&lru);
+}
+
+/* Compressor. */
+
+#define HASH_BITS 12
+#define MIN_MATCH 4
+#define MAX_MATCH (MIN_MATCH + 0x7f)
+#define MAX_LITERALS 0x80
+
+/* Token formats.  A control byte with the top bit clear is followed by
+ * (byte + 1) literal bytes.  One with the top bit set is followed by a
+ * 2-byte little-endian offset, and copies (byte & 0x7f) + MIN_MATCH
+ * bytes from that far back. */
+#define MATCH_BIT 0x80
+
+static uint16_t hash_table[1 << HASH_BITS];
+
+static uint32_t
+read32 (const uint8_t *p) {
+	uint32_t v;
+	memcpy (&v, p, sizeof v);
+	return v;
+}
+
+static unsigned
+hash32 (uint32_t v) {
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the SIZE literal bytes at SRC to the output at *OUT, which
+ * ends at END.  Returns false if they do not fit. */
+static bool
+emit_literals (uint8_t **out, uint8_t *end, const uint8_t *src, size_t size) {
+	while (size > 0) {
+		size_t run = size < MAX_LITERALS ? size : MAX_LITERALS;
+
+		if ((size_t) (end - *out) < run + 1)
+			return false;
+		*(*out)++ = run - 1;
+		memcpy (*out, src, run);
+		*out += run;
+		src += run;
+		size -= run;
+	}
+	return true;
+}
+
+/* Compresses the page at SRC into DST, which has room for DST_SIZE
+ * bytes.  Returns the compressed size, or 0 if it exceeds DST_SIZE. */
+static size_t
+compress (const uint8_t *src, uint8_t *dst, size_t dst_size) {
+	uint8_t *out = dst, *end = dst + dst_size;
+	size_t ip = 0, lit = 0;
+
+	/* Entries hold a position plus 1, so that 0 means none. */
+	memset (hash_table, 0, sizeof hash_table);
+	while (ip + MIN_MATCH <= PGSIZE) {
+		unsigned h = hash32 (read32 (src + ip));
+		size_t cand = hash_table[h];
+		size_t len;
+
+		hash_table[h] = ip + 1;
+		if (cand == 0 || read32 (src + --cand) != read32 (src + ip)) {
+			ip++;
+			continue;
+		}
+
+		for (len = MIN_MATCH; ip + len < PGSIZE && len < MAX_MATCH
+				&& src[cand + len] == src[ip + len]; len++)
+			continue;
+		if (!emit_literals (&out, end, src + lit, ip - lit) || end - out < 3)
+			return 0;
+		*out++ = MATCH_BIT | (len - MIN_MATCH);
+		*out++ = (ip - cand) & 0xff;
+		*out++ = (ip - cand) >> 8;
+		ip += len;
+		lit = ip;
+	}
+	if (!emit_literals (&out, end, src + lit, PGSIZE - lit))
+		return 0;
+	return out - dst;
+}
+
+/* Decompresses the SIZE bytes at SRC into the page at DST. */
+static void
+decompress (const uint8_t *src, size_t size, uint8_t *dst) {
+	const uint8_t *end = src + size;
+	uint8_t *out = dst;
+
+	while (src < end) {
+		uint8_t c = *src++;
+
+		if (c & MATCH_BIT) {
+			size_t len = (c & ~MATCH_BIT) + MIN_MATCH;
+			size_t ofs = src[0] | (src[1] << 8);
+			const uint8_t *from = out - ofs;
+
+			src += 2;
+			ASSERT (from >= dst && out + len <= dst + PGSIZE);
+			/* The source may overlap the destination. */
+			while (len-- > 0)
+				*out++ = *from++;
+		} else {
+			size_t len = c + 1;
+
+			ASSERT (out + len <= dst + PGSIZE);
+			memcpy (out, src, len);
+			src += len;
+			out += len;
+		}
+	}
+	ASSERT (out == dst + PGSIZE);
+}
+
+/* Pool. */
+
+/* Returns a mask of CNT bits starting at bit IDX. */
+static uint64_t
+chunk_mask (size_t idx, size_t cnt) {
+	return (cnt < 64 ? (1ULL << cnt) - 1 : ~0ULL) << idx;
+}
+
+/* Finds room for CNT chunks, adding a pool page if necessary and the
+ * limit allows, and marks them used.  Returns the pool page and stores
+ * the first chunk in *CHUNK, or returns NULL if there is no room. */
+static struct zpage *
+chunks_alloc (size_t cnt, size_t *chunk) {
+	struct list_elem *e;
+	struct zpage *zp;
+	size_t i;
+
+	for (e = list_begin (&zpages); e != list_end (&zpages); e = list_next (e)) {
+		zp = list_entry (e, struct zpage, elem);
+		for (i = 1; i + cnt <= CHUNK_CNT; i++)
+			if ((zp->used & chunk_mask (i, cnt)) == 0)
+				goto found;
+	}
+
+	if (zpage_cnt >= zswap_page_limit)
+		return NULL;
+	zp = palloc_get_page (PAL_TAG (MEM_VM));
+	if (zp == NULL)
+		return NULL;
+	zp->used = 1;               /* Header. */
+	list_push_front (&zpages, &zp->elem);
+	zpage_cnt++;
+	i = 1;
+
+found:
+	zp->used |= chunk_mask (i, cnt);
+	*chunk = i;
+	return zp;
+}
+
+/* Frees the chunks that entry Z uses, and its pool page if it becomes
+ * empty. */
+static void
+chunks_free (struct zswap_entry *z) {
+	struct zpage *zp = z->zpage;
+
+	zp->used &= ~chunk_mask (z->chunk, z->chunk_cnt);
+	if (zp->used == 1) {
+		list_remove (&zp->elem);
+		palloc_free_page (zp);
+		zpage_cnt--;
+	}
+}
+
+/* Returns the address of the data of entry Z. */
+static uint8_t *
+entry_data (struct zswap_entry *z) {
+	return (uint8_t *) z->zpage + z->chunk * CHUNK_SIZE;
+}
+
+/* Compresses the contents of anonymous PAGE, at KVA, into the cache. */
+enum zswap_result
+zswap_store (struct page *page, const void *kva) {
+	enum zswap_result result = ZSWAP_FULL;
+	struct zswap_entry *z;
+	size_t size, chunk;
+
+	ASSERT (page->anon.zentry == NULL);
+
+	if (zswap_page_limit == 0)
+		return ZSWAP_FULL;
+	z = malloc (sizeof *z);
+	if (z == NULL)
+		return ZSWAP_FULL;
+
+	lock_acquire (&zswap_lock);
+	size = compress (kva, scratch, MAX_SIZE);
+	if (size == 0) {
+		result = ZSWAP_INCOMPRESSIBLE;
+		reject_cnt++;
+		goto done;
+	}
+
+	z->chunk_cnt = DIV_ROUND_UP (size, CHUNK_SIZE);
+	z->zpage = chunks_alloc (z->chunk_cnt, &chunk);
+	if (z->zpage == NULL) {
+		full_cnt++;
+		goto done;
+	}
+	z->chunk = chunk;
+	z->size = size;
+	z->page = page;
+	memcpy (entry_data (z), scratch, size);
+	list_push_back (&lru, &z->elem);
+	page->anon.zentry = z;
+
+	stored_cnt++;
+	stored_bytes += size;
+	store_cnt++;
+	size_hist[(size - 1) * 4 / PGSIZE]++;
+	result = ZSWAP_STORED;
+
+done:
+	lock_release (&zswap_lock);
+	if (result != ZSWAP_STORED)
+		free (z);
+	return result;
+}
+
+/* Decompresses PAGE, which must be in the cache, into KVA, and removes
+ * it from the cache. */
+void
+zswap_load (struct page *page, void *kva) {
+	struct zswap_entry *z = page->anon.zentry;
+
+	ASSERT (z != NULL);
+
+	lock_acquire (&zswap_lock);
+	decompress (entry_data (z), z->size, kva);
+	load_cnt++;
+	lock_release (&zswap_lock);
+	zswap_drop (page);
+}
+
+/* Puts in the cache, for PAGE, a copy of the compressed contents of
+ * FROM, which must be there, without decompressing them.  The copy is
+ * as old as the original.  Returns false if there is no room. */
+bool
+zswap_copy (struct page *page, const struct page *from) {
+	struct zswap_entry *src = from->anon.zentry, *z;
+	size_t chunk;
+
+	ASSERT (src != NULL && page->anon.zentry == NULL);
+
+	z = malloc (sizeof *z);
+	if (z == NULL)
+		return false;
+
+	lock_acquire (&zswap_lock);
+	z->zpage = chunks_alloc (src->chunk_cnt, &chunk);
+	if (z->zpage == NULL) {
+		full_cnt++;
+		lock_release (&zswap_lock);
+		free (z);
+		return false;
+	}
+	z->chunk = chunk;
+	z->chunk_cnt = src->chunk_cnt;
+	z->size = src->size;
+	z->page = page;
+	memcpy (entry_data (z), entry_data (src), z->size);
+	list_insert (list_next (&src->elem), &z->elem);
+	page->anon.zentry = z;
+
+	stored_cnt++;
+	stored_bytes += z->size;
+	lock_release (&zswap_lock);
+	return true;
+}
+
+/* Removes PAGE from the cache, if it is there. */
+void
+zswap_drop (struct page *page) {
+	struct zswap_entry *z = page->anon.zentry;
+
+	if (z == NULL)
+		return;
+
+	lock_acquire (&zswap_lock);
+	list_remove (&z->elem);
+	chunks_free (z);
+	stored_cnt--;
+	stored_bytes -= z->size;
+	lock_release (&zswap_lock);
+
+	page->anon.zentry = NULL;
+	free (z);
+}
+
+/* Stores in PAGES up to CNT of the pages that have been in the cache
+ * longest, oldest first, and returns how many it stored. */
+size_t
+zswap_oldest (struct page *pages[], size_t cnt) {
+	struct list_elem *e;
+	size_t i = 0;
+
+	lock_acquire (&zswap_lock);
+	for (e = list_begin (&lru); e != list_end (&lru) && i < cnt;
+			e = list_next (e))
+		pages[i++] = list_entry (e, struct zswap_entry, elem)->page;
+	lock_release (&zswap_lock);
+	return i;
+}
+
+/* Prints compressed cache statistics. */
+void
+zswap_print_stats (void) {
+	printf ("Zswap: %zu pages in %zu of %zu pool pages (%zu%% of original size), "
+			"%llu stored, %llu loaded, %llu incompressible, %llu refused\n",
+			stored_cnt, zpage_cnt, zswap_page_limit,
+			stored_cnt > 0 ? stored_bytes * 100 / (stored_cnt * PGSIZE) : 0,
+			store_cnt, load_cnt, reject_cnt, full_cnt);
+	printf ("Zswap: compressed to <1/4 page %llu, <1/2 %llu, <3/4 %llu\n",
+			size_hist[0], size_hist[1], size_hist[2]);
+}